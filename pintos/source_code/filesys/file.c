@@ -9,6 +9,7 @@ struct file
     struct inode *inode;        /* File's inode. */
     off_t pos;                  /* Current position. */
     bool deny_write;            /* Has file_deny_write() been called? */
+    int ref_cnt;                /* References, see file_dup(). */
   };
 
 /* Opens a file for the given INODE, of which it takes ownership,
@@ -23,6 +24,7 @@ file_open (struct inode *inode)
       file->inode = inode;
       file->pos = 0;
       file->deny_write = false;
+      file->ref_cnt = 1;
       return file;
     }
   else
@@ -41,11 +43,22 @@ file_reopen (struct file *file)
   return file_open (inode_reopen (file->inode));
 }
 
+/* Returns FILE with one more reference to it, for a process that
+   shares it with another, as a child made by fork() does.  Unlike
+   file_reopen(), the position is shared as well.  FILE is closed
+   once every reference has been dropped with file_close(). */
+struct file *
+file_dup (struct file *file) 
+{
+  file->ref_cnt++;
+  return file;
+}
+
 /* Closes FILE. */
 void
 file_close (struct file *file) 
 {
-  if (file != NULL)
+  if (file != NULL && --file->ref_cnt == 0)
     {
       file_allow_write (file);
       inode_close (file->inode);
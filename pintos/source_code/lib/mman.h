@@ -0,0 +1,19 @@
+#ifndef __LIB_MMAN_H
+#define __LIB_MMAN_H
+
+/* Flags for msync() and madvise(), shared by the kernel and user
+   programs. */
+#define MS_ASYNC 0x1            /* Start writing back, do not wait. */
+#define MS_SYNC 0x2             /* Write back before returning. */
+
+/* Advice for madvise(). */
+#define MADV_NORMAL 0           /* No particular access pattern. */
+#define MADV_RANDOM 1           /* Random access: no readahead. */
+#define MADV_SEQUENTIAL 2       /* Sequential access: read ahead far,
+                                   and drop pages once read. */
+#define MADV_WILLNEED 3         /* Will be needed: read in now. */
+#define MADV_DONTNEED 4         /* Not needed: free the memory. */
+#define MADV_HUGEPAGE 5         /* Map with 4 MB pages where possible. */
+#define MADV_NOHUGEPAGE 6       /* Map with 4 kB pages only. */
+
+#endif /* lib/mman.h */
@@ -28,7 +28,16 @@ enum
     SYS_MKDIR,                  /* Create a directory. */
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-    SYS_INUMBER                 /* Returns the inode number for a fd. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+
+    /* Extensions. */
+    SYS_FORK,                   /* Duplicate this process. */
+    SYS_FAULTSTAT,              /* Obtain page fault statistics. */
+    SYS_MSYNC,                  /* Write back a memory mapping. */
+    SYS_MADVISE,                /* Advise on the use of memory. */
+    SYS_RSSLIMIT,               /* Limit memory of processes exec'd. */
+    SYS_MERGESTAT,              /* Obtain page merging statistics. */
+    SYS_SWAPSTAT                /* Obtain swap use. */
   };
 
 #endif /* lib/syscall-nr.h */
@@ -182,3 +182,46 @@ inumber (int fd)
 {
   return syscall1 (SYS_INUMBER, fd);
 }
+
+pid_t
+fork (void)
+{
+  return (pid_t) syscall0 (SYS_FORK);
+}
+
+void
+faultstat (struct fault_stats *process, struct fault_stats *all,
+           struct fault_hist *hist)
+{
+  syscall3 (SYS_FAULTSTAT, process, all, hist);
+}
+
+int
+msync (void *addr, unsigned length, int flags)
+{
+  return syscall3 (SYS_MSYNC, addr, length, flags);
+}
+
+int
+madvise (void *addr, unsigned length, int advice)
+{
+  return syscall3 (SYS_MADVISE, addr, length, advice);
+}
+
+void
+rsslimit (unsigned pages)
+{
+  syscall1 (SYS_RSSLIMIT, pages);
+}
+
+void
+mergestat (struct merge_stats *stats, bool wait)
+{
+  syscall2 (SYS_MERGESTAT, stats, wait);
+}
+
+void
+swapstat (struct swap_stats *process, struct swap_stats *all)
+{
+  syscall2 (SYS_SWAPSTAT, process, all);
+}
@@ -3,6 +3,8 @@
 
 #include <stdbool.h>
 #include <debug.h>
+#include <mman.h>
+#include <vmstat.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -45,4 +47,14 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* Extensions. */
+pid_t fork (void);
+void faultstat (struct fault_stats *process, struct fault_stats *all,
+                struct fault_hist *hist);
+int msync (void *addr, unsigned length, int flags);
+int madvise (void *addr, unsigned length, int advice);
+void rsslimit (unsigned pages);
+void mergestat (struct merge_stats *stats, bool wait);
+void swapstat (struct swap_stats *process, struct swap_stats *all);
+
 #endif /* lib/user/syscall.h */
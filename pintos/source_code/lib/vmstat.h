@@ -0,0 +1,65 @@
+#ifndef __LIB_VMSTAT_H
+#define __LIB_VMSTAT_H
+
+/* Page fault and memory statistics, shared by the kernel and user
+   programs through the faultstat, mergestat and swapstat system
+   calls. */
+
+/* Classes of user page faults. */
+enum fault_class
+  {
+    FAULT_FILE,                 /* Page read from an executable. */
+    FAULT_MMAP,                 /* Page read from a mapped file. */
+    FAULT_SWAP,                 /* Page read back from swap. */
+    FAULT_ANON,                 /* Zero-filled page, including bss. */
+    FAULT_STACK,                /* Stack growth. */
+    FAULT_COW,                  /* Write to a shared read-only page. */
+    FAULT_CLASS_CNT
+  };
+
+/* Fault counts, for a process or for the whole system. */
+struct fault_stats
+  {
+    long long count[FAULT_CLASS_CNT];   /* Faults of each class. */
+    long long cycles[FAULT_CLASS_CNT];  /* CPU cycles spent on them. */
+    long long evict_cnt;                /* Frames evicted by faults. */
+    long long evict_cycles;             /* CPU cycles spent evicting. */
+    long long rss;                      /* Frames mapped now: by the
+                                           process, or user frames in
+                                           use system-wide. */
+  };
+
+/* Latency histograms, in CPU cycles.  Bucket I counts events that
+   took fewer than 2**(I+1) cycles. */
+#define FAULT_LAT_BUCKETS 32
+struct fault_hist
+  {
+    long long load[FAULT_LAT_BUCKETS];  /* Handling a fault. */
+    long long evict[FAULT_LAT_BUCKETS]; /* Evicting a frame for one. */
+  };
+
+/* Same-page merging statistics, for the whole system, through the
+   mergestat system call. */
+struct merge_stats
+  {
+    long long shared;           /* Frames holding merged pages. */
+    long long sharing;          /* Further pages mapped to them: the
+                                   frames merging saves. */
+    long long merged;           /* Pages merged so far. */
+    long long scanned;          /* Frames hashed by the scanner. */
+    long long scan_cycles;      /* CPU cycles the scanner spent. */
+  };
+
+/* Swap use, for a process or for the whole system. */
+struct swap_stats
+  {
+    long long pages;            /* Pages in swap.  System-wide, slots
+                                   in use, each of which may hold a
+                                   page of several processes. */
+    long long reserved;         /* Anonymous pages swap is reserved
+                                   for. */
+    long long size;             /* Swap slots in all; system-wide
+                                   only. */
+  };
+
+#endif /* lib/vmstat.h */
@@ -0,0 +1,59 @@
+/* Child process of page-dedup.
+   Fills memory with data that depends only on the page, the same
+   in every copy of this program, and waits for the page merging
+   scanner to merge it with the other copy's.  Then writes its own
+   ID, given as its argument, to every other page, which must make
+   a private copy of each, and checks what every page holds. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include <vmstat.h>
+#include "tests/lib.h"
+
+const char *test_name = "child-dedup";
+
+#define PAGES 32
+#define PASSES 20
+
+static char buf[PAGES * 4096];
+
+/* Returns the byte page I is filled with. */
+static char
+pattern (int i)
+{
+  return (char) (i * 7 + 3);
+}
+
+int
+main (int argc UNUSED, char *argv[])
+{
+  struct merge_stats st;
+  char id = atoi (argv[1]);
+  int i, pass;
+  size_t j;
+
+  for (i = 0; i < PAGES; i++)
+    memset (buf + i * 4096, pattern (i), 4096);
+
+  /* The other child may not have filled its pages yet. */
+  mergestat (&st, false);
+  for (pass = 0; pass < PASSES && st.sharing < PAGES; pass++)
+    mergestat (&st, true);
+  if (st.sharing < PAGES)
+    fail ("only %lld pages merged", st.sharing);
+
+  for (i = 0; i < PAGES; i += 2)
+    buf[i * 4096] = id;
+  mergestat (&st, true);
+
+  for (i = 0; i < PAGES; i++)
+    for (j = 0; j < 4096; j++)
+      {
+        char expected = j == 0 && i % 2 == 0 ? id : pattern (i);
+        if (buf[i * 4096 + j] != expected)
+          fail ("byte %zu of page %d is %d, not %d",
+                j, i, buf[i * 4096 + j], expected);
+      }
+  return 0;
+}
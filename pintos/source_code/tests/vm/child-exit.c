@@ -0,0 +1,8 @@
+/* Child process of fork-bench.
+   Exits at once. */
+
+int
+main (void)
+{
+  return 0;
+}
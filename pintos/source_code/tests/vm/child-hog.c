@@ -0,0 +1,29 @@
+/* Child process of rss-hog.
+   Streams through 2 MB of memory several times, writing every
+   page, and checks the data it wrote. */
+
+#include "tests/lib.h"
+#include "tests/main.h"
+
+const char *test_name = "child-hog";
+
+#define SIZE (2 * 1024 * 1024)
+#define PASSES 4
+
+static char buf[SIZE];
+
+int
+main (void)
+{
+  size_t i;
+  int pass;
+
+  for (pass = 0; pass < PASSES; pass++)
+    for (i = 0; i < SIZE; i += 4096)
+      {
+        if (pass > 0 && buf[i] != (char) (pass - 1 + i / 4096))
+          fail ("byte %zu is wrong in pass %d", i, pass);
+        buf[i] = (char) (pass + i / 4096);
+      }
+  return 0;
+}
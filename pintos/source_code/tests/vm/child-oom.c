@@ -0,0 +1,25 @@
+/* Child process of oom-kill.
+   Writes 2 MB of memory and reads it back.  Several of these at
+   once need more memory than there is, swap included. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+
+const char *test_name = "child-oom";
+
+#define PAGES 512
+
+static char buf[PAGES * 4096];
+
+int
+main (void)
+{
+  int i;
+
+  for (i = 0; i < PAGES; i++)
+    buf[i * 4096] = (char) i;
+  for (i = 0; i < PAGES; i++)
+    if (buf[i * 4096] != (char) i)
+      fail ("page %d is wrong", i);
+  return 0;
+}
@@ -0,0 +1,33 @@
+/* Child process of swap-reclaim.
+   Writes 2 MB of memory, more than there is, so that much of it
+   goes to swap, checks that swap is reserved for all of it, and
+   reads it back. */
+
+#include <syscall.h>
+#include <vmstat.h>
+#include "tests/lib.h"
+
+const char *test_name = "child-swap";
+
+#define PAGES 512
+
+static char buf[PAGES * 4096];
+
+int
+main (void)
+{
+  struct swap_stats st;
+  int i;
+
+  for (i = 0; i < PAGES; i++)
+    buf[i * 4096] = (char) i;
+
+  swapstat (&st, NULL);
+  if (st.reserved < PAGES)
+    fail ("swap reserved for %lld pages only", st.reserved);
+
+  for (i = 0; i < PAGES; i++)
+    if (buf[i * 4096] != (char) i)
+      fail ("page %d is wrong", i);
+  return 0;
+}
@@ -0,0 +1,27 @@
+/* Runs child-linear, which uses 1 MB of memory, several times in
+   a row.  Each child's address space is freed by the reaper after
+   its exit status is already known, while the next child runs, so
+   that memory has to come back from the reaper for the children
+   to keep running. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHILD_CNT 8
+
+void
+test_main (void)
+{
+  int i;
+
+  for (i = 0; i < CHILD_CNT; i++)
+    {
+      pid_t child = exec ("child-linear");
+      if (child == PID_ERROR)
+        fail ("exec \"child-linear\" %d failed", i);
+      if (wait (child) != 0x42)
+        fail ("child %d failed", i);
+    }
+  msg ("ran %d children", CHILD_CNT);
+}
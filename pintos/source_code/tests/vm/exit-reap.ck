@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(exit-reap) begin
+(exit-reap) ran 8 children
+(exit-reap) end
+EOF
+pass;
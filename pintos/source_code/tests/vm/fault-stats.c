@@ -0,0 +1,68 @@
+/* Touches memory in ways that cause each kind of page fault and
+   checks that the faultstat system call counts them, for the
+   process and for the whole system. */
+
+#include <string.h>
+#include <syscall.h>
+#include <vmstat.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGES 16
+#define PAGE_SIZE 4096
+
+static char data[PAGES * PAGE_SIZE] = {1};
+static char bss[PAGES * PAGE_SIZE];
+
+/* Grows the stack by a few pages. */
+static void __attribute__ ((noinline))
+grow_stack (void)
+{
+  volatile char stack[4 * PAGE_SIZE];
+  size_t i;
+
+  for (i = 0; i < sizeof stack; i += PAGE_SIZE)
+    stack[i] = 1;
+}
+
+void
+test_main (void)
+{
+  struct fault_stats before, after, all;
+  struct fault_hist hist;
+  long long hist_cnt = 0;
+  volatile char sum = 0;
+  int c, i;
+
+  faultstat (&before, NULL, NULL);
+
+  /* Reads map the zero page, and writes then break it.  The first
+     bss page may share a page with the end of the data. */
+  for (i = 0; i < PAGES; i++)
+    sum += bss[i * PAGE_SIZE];
+  for (i = 0; i < PAGES; i++)
+    bss[i * PAGE_SIZE] = 1;
+  for (i = 0; i < PAGES; i++)
+    sum += data[i * PAGE_SIZE];
+  grow_stack ();
+
+  faultstat (&after, &all, &hist);
+  if (after.count[FAULT_ANON] - before.count[FAULT_ANON] < PAGES - 1)
+    fail ("anon faults not counted");
+  if (after.count[FAULT_COW] - before.count[FAULT_COW] < PAGES - 1)
+    fail ("copy-on-write faults not counted");
+  if (after.count[FAULT_FILE] - before.count[FAULT_FILE] < 1)
+    fail ("file faults not counted");
+  if (after.count[FAULT_STACK] - before.count[FAULT_STACK] < 1)
+    fail ("stack faults not counted");
+  msg ("process counts ok");
+
+  for (c = 0; c < FAULT_CLASS_CNT; c++)
+    if (all.count[c] < after.count[c])
+      fail ("system count below process count");
+  for (i = 0; i < FAULT_LAT_BUCKETS; i++)
+    hist_cnt += hist.load[i];
+  if (hist_cnt < all.count[FAULT_ANON] + all.count[FAULT_COW])
+    fail ("latency histogram misses faults");
+  msg ("system counts ok");
+}
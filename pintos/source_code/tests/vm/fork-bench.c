@@ -0,0 +1,56 @@
+/* Measures how long it takes to create a process with fork() and
+   with exec(), the child exiting at once and the parent waiting
+   for it.  The parent first touches some memory, so that fork()
+   has an address space to share. */
+
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ROUNDS 20
+#define SIZE (256 * 1024)
+
+static char buf[SIZE];
+
+static inline uint64_t
+rdtsc (void)
+{
+  uint32_t lo, hi;
+  asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((uint64_t) hi << 32) | lo;
+}
+
+void
+test_main (void)
+{
+  uint64_t start, fork_cycles, exec_cycles;
+  pid_t pid;
+  int i;
+
+  for (i = 0; i < SIZE; i += 4096)
+    buf[i] = 1;
+
+  start = rdtsc ();
+  for (i = 0; i < ROUNDS; i++)
+    {
+      pid = fork ();
+      if (pid == 0)
+        exit (0);
+      if (pid == PID_ERROR || wait (pid) != 0)
+        fail ("fork round %d failed", i);
+    }
+  fork_cycles = (rdtsc () - start) / ROUNDS;
+
+  start = rdtsc ();
+  for (i = 0; i < ROUNDS; i++)
+    {
+      pid = exec ("child-exit");
+      if (pid == PID_ERROR || wait (pid) != 0)
+        fail ("exec round %d failed", i);
+    }
+  exec_cycles = (rdtsc () - start) / ROUNDS;
+
+  msg ("fork+exit: %llu cycles per process", fork_cycles);
+  msg ("exec+exit: %llu cycles per process", exec_cycles);
+}
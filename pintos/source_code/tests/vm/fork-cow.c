@@ -0,0 +1,78 @@
+/* Forks a process and checks that the child starts with the
+   parent's memory, open files and file mappings, and that writes
+   by the child are not seen by the parent.  Then reads from a
+   file into the parent's data, whose pages fork() mapped
+   read-only and the child no longer shares. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (64 * 1024)
+
+static char data[SIZE] = {1};
+static char bss[SIZE];
+
+/* Returns true if all SIZE bytes of BUF are C. */
+static bool
+all (const char *buf, char c)
+{
+  size_t i;
+
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != c)
+      return false;
+  return true;
+}
+
+void
+test_main (void)
+{
+  char *map = (char *) 0x10000000;
+  char buf[16];
+  int handle;
+  pid_t child;
+
+  memset (data, 'p', SIZE);
+  memset (bss, 'p', SIZE / 2);
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (mmap (handle, map) != MAP_FAILED, "mmap \"sample.txt\"");
+  map[0] = 'P';
+
+  child = fork ();
+  if (child == 0)
+    {
+      msg ("child: checking memory");
+      if (!all (data, 'p'))
+        fail ("child: data differs from parent's");
+      if (bss[0] != 'p' || bss[SIZE / 2 - 1] != 'p'
+          || bss[SIZE / 2] != 0 || bss[SIZE - 1] != 0)
+        fail ("child: bss differs from parent's");
+      if (map[0] != 'P' || memcmp (map + 1, sample + 1, strlen (sample) - 1))
+        fail ("child: mapping differs from parent's");
+      memset (data, 'c', SIZE);
+      memset (bss, 'c', SIZE);
+      CHECK (read (handle, buf, sizeof buf) == sizeof buf,
+             "child: read \"sample.txt\"");
+      exit (all (data, 'c') && all (bss, 'c') ? 42 : -1);
+    }
+  if (child == PID_ERROR)
+    fail ("fork failed");
+
+  quiet = true;
+  CHECK (wait (child) == 42, "wait for child");
+  quiet = false;
+
+  CHECK (all (data, 'p') && bss[0] == 'p' && bss[SIZE - 1] == 0,
+         "checking parent memory");
+  CHECK (map[0] == 'P', "checking parent mapping");
+  CHECK (tell (handle) == sizeof buf, "checking shared file position");
+
+  seek (handle, 0);
+  CHECK (read (handle, data, sizeof buf) == sizeof buf,
+         "read \"sample.txt\" into parent data");
+  CHECK (!memcmp (data, sample, sizeof buf) && data[sizeof buf] == 'p',
+         "checking parent data");
+}
@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(fork-cow) begin
+(fork-cow) open "sample.txt"
+(fork-cow) mmap "sample.txt"
+(fork-cow) child: checking memory
+(fork-cow) child: read "sample.txt"
+fork-cow: exit(42)
+(fork-cow) checking parent memory
+(fork-cow) checking parent mapping
+(fork-cow) checking shared file position
+(fork-cow) read "sample.txt" into parent data
+(fork-cow) checking parent data
+(fork-cow) end
+fork-cow: exit(0)
+EOF
+pass;
@@ -0,0 +1,102 @@
+/* Microbenchmark of large pages.  Walks two 4 MB blocks of bss,
+   one word per page, in an order that makes every access use a
+   different TLB entry when the block is mapped with 4 kB pages: the
+   first block before madvise(MADV_HUGEPAGE), the second after it,
+   when the kernel can map it with a single 4 MB page.  Reports the
+   faults taken to bring each block in and the cycles per access
+   of each walk; the ratio of the two, not their values, is what
+   carries over between machines and emulators.  The kernel falls
+   back to 4 kB pages if it cannot find 4 MB of free, aligned
+   frames, so the test only checks that the data is right. */
+
+#include <mman.h>
+#include <stdint.h>
+#include <syscall.h>
+#include <vmstat.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define BLOCK_SIZE (4 * 1024 * 1024)
+#define BLOCK_PAGES (BLOCK_SIZE / PAGE_SIZE)
+#define STRIDE 97               /* Odd, so the walk visits every page. */
+#define PASSES 16
+
+/* Room for two aligned blocks wherever the linker puts it. */
+static char buf[3 * BLOCK_SIZE];
+
+static inline uint64_t
+rdtsc (void)
+{
+  uint32_t lo, hi;
+  asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((uint64_t) hi << 32) | lo;
+}
+
+/* Returns the number of page faults taken by this process. */
+static long long
+fault_cnt (void)
+{
+  struct fault_stats st;
+  long long cnt = 0;
+  int c;
+
+  faultstat (&st, NULL, NULL);
+  for (c = 0; c < FAULT_CLASS_CNT; c++)
+    cnt += st.count[c];
+  return cnt;
+}
+
+/* Brings BLOCK in, writing each page's number to it, and returns
+   the faults taken. */
+static long long
+fill (int *block)
+{
+  long long before = fault_cnt ();
+  int i;
+
+  for (i = 0; i < BLOCK_PAGES; i++)
+    block[i * PAGE_SIZE / sizeof *block] = i;
+  return fault_cnt () - before;
+}
+
+/* Walks BLOCK PASSES times, checking each page, and returns the
+   average cycles per access. */
+static uint64_t
+walk (int *block)
+{
+  uint64_t start = rdtsc ();
+  int pass, i, page = 0;
+
+  for (pass = 0; pass < PASSES; pass++)
+    for (i = 0; i < BLOCK_PAGES; i++)
+      {
+        page = (page + STRIDE) % BLOCK_PAGES;
+        if (block[page * PAGE_SIZE / sizeof *block] != page)
+          fail ("page %d reads %d", page,
+                block[page * PAGE_SIZE / sizeof *block]);
+      }
+  return (rdtsc () - start) / (PASSES * BLOCK_PAGES);
+}
+
+void
+test_main (void)
+{
+  int *small = (int *) (((uintptr_t) buf + BLOCK_SIZE - 1)
+                        & ~(uintptr_t) (BLOCK_SIZE - 1));
+  int *large = (int *) ((char *) small + BLOCK_SIZE);
+  long long small_faults, large_faults;
+
+  small_faults = fill (small);
+  CHECK (madvise (buf, sizeof buf, MADV_HUGEPAGE) == 0,
+         "madvise hugepage");
+  large_faults = fill (large);
+
+  msg ("4 kB pages: %lld faults", small_faults);
+  msg ("4 kB pages: %llu cycles per access", walk (small));
+  msg ("large pages: %lld faults", large_faults);
+  msg ("large pages: %llu cycles per access", walk (large));
+
+  CHECK (madvise (buf, sizeof buf, MADV_NOHUGEPAGE) == 0,
+         "madvise nohugepage");
+}
@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+
+# The results vary from run to run; only check that all are there.
+my ($result) = qr/ pages: \d+ (faults|cycles per access)$/;
+fail "missing results in output\n" if grep (/$result/, @output) != 4;
+@output = grep (!/$result/, @output);
+
+compare_output ("run", IGNORE_EXIT_CODES => 1, \@output, [<<'EOF']);
+(large-page) begin
+(large-page) madvise hugepage
+(large-page) madvise nohugepage
+(large-page) end
+EOF
+pass;
@@ -0,0 +1,81 @@
+/* Checks that madvise() accepts each kind of advice, that
+   MADV_DONTNEED throws away what was written to bss and data pages,
+   that MADV_WILLNEED on a file mapping reads the right data, and
+   that advice for one page of a mapping, which splits its region,
+   leaves the whole mapping readable and removed by munmap(). */
+
+#include <round.h>
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define SIZE (4 * PAGE_SIZE)
+
+#define ACTUAL ((void *) 0x10000000)
+
+static char data[SIZE] = {1};
+static char bss[SIZE];
+
+/* Returns the first whole page of BUF, which is SIZE bytes long.
+   Discarding it touches nothing else. */
+static char *
+inner_page (char *buf)
+{
+  return (char *) ROUND_UP ((uintptr_t) buf + 1, PAGE_SIZE);
+}
+
+void
+test_main (void)
+{
+  char *b = inner_page (bss);
+  char *d = inner_page (data);
+  int handle;
+  mapid_t map;
+
+  memset (b, 'b', PAGE_SIZE);
+  memset (d, 'd', PAGE_SIZE);
+  CHECK (madvise (b, PAGE_SIZE, MADV_DONTNEED) == 0, "madvise bss dontneed");
+  CHECK (madvise (d, PAGE_SIZE, MADV_DONTNEED) == 0,
+         "madvise data dontneed");
+  if (b[0] != 0 || b[PAGE_SIZE - 1] != 0)
+    fail ("bss page kept its contents");
+  if (d[0] != 0 || d[PAGE_SIZE - 1] != 0)
+    fail ("data page kept its contents");
+  msg ("discarded pages read back as in the executable");
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK ((map = mmap (handle, ACTUAL)) != MAP_FAILED, "mmap \"sample.txt\"");
+  CHECK (madvise (ACTUAL, strlen (sample), MADV_WILLNEED) == 0,
+         "madvise willneed");
+  CHECK (madvise (ACTUAL, strlen (sample), MADV_SEQUENTIAL) == 0,
+         "madvise sequential");
+  CHECK (madvise (ACTUAL, strlen (sample), MADV_RANDOM) == 0,
+         "madvise random");
+  if (memcmp (ACTUAL, sample, strlen (sample)))
+    fail ("read of mapped file is incorrect");
+  msg ("mapped file reads correctly");
+
+  CHECK (madvise (ACTUAL, 1, 99) == -1, "madvise with bad advice fails");
+  CHECK (madvise ((char *) ACTUAL + 0x100000, 1, MADV_WILLNEED) == -1,
+         "madvise of unmapped range fails");
+  munmap (map);
+
+  memset (data, 'm', SIZE);
+  CHECK (create ("big.txt", 3 * PAGE_SIZE), "create \"big.txt\"");
+  CHECK ((handle = open ("big.txt")) > 1, "open \"big.txt\"");
+  CHECK (write (handle, data, 3 * PAGE_SIZE) == 3 * PAGE_SIZE,
+         "write \"big.txt\"");
+  CHECK ((map = mmap (handle, ACTUAL)) != MAP_FAILED, "mmap \"big.txt\"");
+  CHECK (madvise ((char *) ACTUAL + PAGE_SIZE, PAGE_SIZE,
+                  MADV_SEQUENTIAL) == 0, "madvise middle page sequential");
+  if (memcmp (ACTUAL, data, 3 * PAGE_SIZE))
+    fail ("read of split mapping is incorrect");
+  munmap (map);
+  CHECK ((map = mmap (handle, ACTUAL)) != MAP_FAILED,
+         "mmap \"big.txt\" again after munmap");
+  munmap (map);
+}
@@ -0,0 +1,26 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(madvise) begin
+(madvise) madvise bss dontneed
+(madvise) madvise data dontneed
+(madvise) discarded pages read back as in the executable
+(madvise) open "sample.txt"
+(madvise) mmap "sample.txt"
+(madvise) madvise willneed
+(madvise) madvise sequential
+(madvise) madvise random
+(madvise) mapped file reads correctly
+(madvise) madvise with bad advice fails
+(madvise) madvise of unmapped range fails
+(madvise) create "big.txt"
+(madvise) open "big.txt"
+(madvise) write "big.txt"
+(madvise) mmap "big.txt"
+(madvise) madvise middle page sequential
+(madvise) mmap "big.txt" again after munmap
+(madvise) end
+EOF
+pass;
@@ -0,0 +1,41 @@
+/* Writes to a file through a mapping and writes it back with
+   msync(), then reads the data in the file back using the read
+   system call, while the file is still mapped, to verify.  Also
+   checks that msync() rejects bad arguments. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ACTUAL ((void *) 0x10000000)
+
+void
+test_main (void)
+{
+  int handle;
+  mapid_t map;
+  char buf[1024];
+
+  CHECK (create ("sample.txt", strlen (sample)), "create \"sample.txt\"");
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK ((map = mmap (handle, ACTUAL)) != MAP_FAILED, "mmap \"sample.txt\"");
+  memcpy (ACTUAL, sample, strlen (sample));
+  CHECK (msync (ACTUAL, strlen (sample), MS_SYNC) == 0, "msync");
+
+  /* Read back via read(), with the mapping still in place. */
+  read (handle, buf, strlen (sample));
+  CHECK (!memcmp (buf, sample, strlen (sample)),
+         "compare read data against written data");
+
+  CHECK (msync ((char *) ACTUAL + 1, 1, MS_SYNC) == -1,
+         "msync of unaligned address fails");
+  CHECK (msync ((char *) ACTUAL + 0x100000, 1, MS_ASYNC) == -1,
+         "msync of unmapped range fails");
+  CHECK (msync (ACTUAL, 1, MS_ASYNC | MS_SYNC) == -1,
+         "msync with both flags fails");
+  CHECK (msync (ACTUAL, strlen (sample), MS_ASYNC) == 0, "msync async");
+  munmap (map);
+  close (handle);
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-msync) begin
+(mmap-msync) create "sample.txt"
+(mmap-msync) open "sample.txt"
+(mmap-msync) mmap "sample.txt"
+(mmap-msync) msync
+(mmap-msync) compare read data against written data
+(mmap-msync) msync of unaligned address fails
+(mmap-msync) msync of unmapped range fails
+(mmap-msync) msync with both flags fails
+(mmap-msync) msync async
+(mmap-msync) end
+EOF
+pass;
@@ -0,0 +1,40 @@
+/* Runs child-oom in several processes at once, which together
+   need more memory than there is, swap included, with pages
+   created without reserving swap for them.  The kernel must kill
+   some of the children, which exit with -1, and let the others
+   finish.  Then it runs one more child, which must find enough
+   memory again. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHILD_CNT 6
+
+void
+test_main (void)
+{
+  pid_t children[CHILD_CNT];
+  int killed = 0, finished = 0;
+  int i;
+
+  for (i = 0; i < CHILD_CNT; i++)
+    {
+      children[i] = exec ("child-oom");
+      if (children[i] == PID_ERROR)
+        fail ("exec \"child-oom\" %d failed", i);
+    }
+  for (i = 0; i < CHILD_CNT; i++)
+    {
+      int status = wait (children[i]);
+      if (status == -1)
+        killed++;
+      else if (status == 0)
+        finished++;
+      else
+        fail ("child %d exited with %d", i, status);
+    }
+  CHECK (killed > 0, "some children were killed");
+  CHECK (finished > 0, "some children finished");
+  CHECK (wait (exec ("child-oom")) == 0, "child run alone finished");
+}
@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+
+# The processes killed, and their sizes, vary from run to run.
+@output = grep (!/^Out of memory: killed process /, @output);
+
+compare_output ("run", IGNORE_EXIT_CODES => 1, \@output, [<<'EOF']);
+(oom-kill) begin
+(oom-kill) some children were killed
+(oom-kill) some children finished
+(oom-kill) child run alone finished
+(oom-kill) end
+EOF
+pass;
@@ -0,0 +1,26 @@
+/* Runs two processes that fill memory with the same data, which
+   the page merging scanner should merge, and then write to part of
+   it, which must give each process its own copy of those pages
+   again.  See child-dedup.c. */
+
+#include <syscall.h>
+#include <vmstat.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGES 32
+
+void
+test_main (void)
+{
+  struct merge_stats st;
+  pid_t a, b;
+
+  CHECK ((a = exec ("child-dedup 1")) != PID_ERROR, "exec \"child-dedup 1\"");
+  CHECK ((b = exec ("child-dedup 2")) != PID_ERROR, "exec \"child-dedup 2\"");
+  CHECK (wait (a) == 0, "wait for child 1");
+  CHECK (wait (b) == 0, "wait for child 2");
+
+  mergestat (&st, false);
+  CHECK (st.merged >= PAGES, "pages merged");
+}
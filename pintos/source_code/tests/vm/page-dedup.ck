@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-dedup) begin
+(page-dedup) exec "child-dedup 1"
+(page-dedup) exec "child-dedup 2"
+(page-dedup) wait for child 1
+(page-dedup) wait for child 2
+(page-dedup) pages merged
+(page-dedup) end
+EOF
+pass;
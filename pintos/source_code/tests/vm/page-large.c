@@ -0,0 +1,54 @@
+/* Touches 3 MB of memory, more than fits in the user pool, in
+   several passes with different strides, so that the page
+   replacement policy runs continuously.  Verifies the contents
+   after every pass. */
+
+#include <string.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (3 * 1024 * 1024)
+#define PAGE_SIZE 4096
+
+static char buf[SIZE];
+
+static void
+check (const char *pass, size_t bias)
+{
+  size_t i;
+
+  msg ("check after %s", pass);
+  for (i = 0; i < SIZE; i += PAGE_SIZE)
+    if (buf[i] != (char) ((i / PAGE_SIZE + bias) & 0xff))
+      fail ("byte %zu is %d, expected %d", i, buf[i],
+            (int) ((i / PAGE_SIZE + bias) & 0xff));
+}
+
+void
+test_main (void)
+{
+  size_t i, stride;
+
+  msg ("initialize");
+  for (i = 0; i < SIZE; i += PAGE_SIZE)
+    buf[i] = (char) (i / PAGE_SIZE);
+  check ("initialize", 0);
+
+  /* Revisit the pages in a few interleaved orders, bumping each
+     page's marker once per pass. */
+  for (stride = 1; stride <= 7; stride += 3)
+    {
+      size_t start;
+
+      msg ("stride %zu pass", stride);
+      for (start = 0; start < stride; start++)
+        for (i = start * PAGE_SIZE; i < SIZE; i += stride * PAGE_SIZE)
+          buf[i]++;
+    }
+  check ("stride passes", 3);
+
+  msg ("backward pass");
+  for (i = SIZE; i > 0; i -= PAGE_SIZE)
+    buf[i - PAGE_SIZE]--;
+  check ("backward pass", 2);
+}
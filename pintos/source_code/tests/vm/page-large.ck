@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-large) begin
+(page-large) initialize
+(page-large) check after initialize
+(page-large) stride 1 pass
+(page-large) stride 4 pass
+(page-large) stride 7 pass
+(page-large) check after stride passes
+(page-large) backward pass
+(page-large) check after backward pass
+(page-large) end
+EOF
+pass;
@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+
+# The results vary from run to run; only check that both are there.
+my (@results) = grep (/: \d+ (faults in \d+ rounds|cycles per round)$/,
+                      @output);
+fail "missing results in output\n" if @results != 2;
+@output = grep (!/: \d+ (faults in \d+ rounds|cycles per round)$/,
+                @output);
+
+compare_output ("run", IGNORE_EXIT_CODES => 1, \@output, [<<'EOF']);
+(page-scan-mix-2q) begin
+(page-scan-mix-2q) end
+EOF
+pass;
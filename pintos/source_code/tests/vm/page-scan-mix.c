@@ -0,0 +1,83 @@
+/* Benchmark of page replacement under a mix of workloads: a hot
+   set of pages, touched again and again, interleaved with scans
+   through much more memory than there is, each page touched once
+   per scan.  Reports the faults taken on the hot set and the time
+   per round.  A scan resistant policy keeps the hot set resident
+   across the scans.  Run as page-scan-mix with clock replacement
+   and as page-scan-mix-2q with -rp=2q. */
+
+#include <stdint.h>
+#include <syscall.h>
+#include <vmstat.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define HOT_PAGES 64
+#define HOT_TOUCHES 4
+#define SCAN_SIZE (2 * 1024 * 1024)
+#define ROUNDS 8
+
+static char hot[HOT_PAGES * PAGE_SIZE];
+static char scan[SCAN_SIZE];
+
+static inline uint64_t
+rdtsc (void)
+{
+  uint32_t lo, hi;
+  asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((uint64_t) hi << 32) | lo;
+}
+
+/* Returns the number of page faults taken by this process. */
+static long long
+fault_cnt (void)
+{
+  struct fault_stats st;
+  long long cnt = 0;
+  int c;
+
+  faultstat (&st, NULL, NULL);
+  for (c = 0; c < FAULT_CLASS_CNT; c++)
+    cnt += st.count[c];
+  return cnt;
+}
+
+void
+test_main (void)
+{
+  long long hot_faults = 0;
+  uint64_t start;
+  size_t i;
+  int round, t;
+
+  /* Warm up: bring the hot set in, and let it be scanned out once,
+     so that it can come back hot. */
+  for (i = 0; i < sizeof hot; i += PAGE_SIZE)
+    hot[i] = 1;
+  for (i = 0; i < SCAN_SIZE; i += PAGE_SIZE)
+    scan[i] = 1;
+
+  start = rdtsc ();
+  for (round = 0; round < ROUNDS; round++)
+    {
+      long long before = fault_cnt ();
+      for (t = 0; t < HOT_TOUCHES; t++)
+        for (i = 0; i < sizeof hot; i += PAGE_SIZE)
+          hot[i]++;
+      hot_faults += fault_cnt () - before;
+
+      for (i = 0; i < SCAN_SIZE; i += PAGE_SIZE)
+        scan[i]++;
+    }
+
+  for (i = 0; i < sizeof hot; i += PAGE_SIZE)
+    if (hot[i] != (char) (1 + ROUNDS * HOT_TOUCHES))
+      fail ("hot page %zu is wrong", i / PAGE_SIZE);
+  for (i = 0; i < SCAN_SIZE; i += PAGE_SIZE)
+    if (scan[i] != (char) (1 + ROUNDS))
+      fail ("scanned page %zu is wrong", i / PAGE_SIZE);
+
+  msg ("hot set: %lld faults in %d rounds", hot_faults, ROUNDS);
+  msg ("scan+hot: %llu cycles per round", (rdtsc () - start) / ROUNDS);
+}
@@ -0,0 +1,66 @@
+/* Reads all of a 3 MB bss array, which can be done without giving
+   it any memory of its own, then writes one byte in every 16th
+   page and verifies that only those bytes changed.  Checks with
+   faultstat() that reading took no frames for the array, and that
+   writing took one for each page written. */
+
+#include <string.h>
+#include <syscall.h>
+#include <vmstat.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (3 * 1024 * 1024)
+#define STRIDE (16 * 4096)
+
+/* Frames the test needs besides BUF's: code, data and stack. */
+#define OTHER_FRAMES 32
+
+static char buf[SIZE];
+
+/* Value written at byte I, or 0 for bytes that are not written. */
+static char
+expected (size_t i)
+{
+  return i % STRIDE == 0 ? (i / STRIDE) % 255 + 1 : 0;
+}
+
+/* Returns the number of frames this process has mapped. */
+static long long
+resident (void)
+{
+  struct fault_stats st;
+
+  faultstat (&st, NULL, NULL);
+  return st.rss;
+}
+
+void
+test_main (void)
+{
+  long long rss;
+  size_t i;
+
+  msg ("read pass");
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != 0)
+      fail ("byte %zu != 0", i);
+  rss = resident ();
+  if (rss > OTHER_FRAMES)
+    fail ("%lld frames mapped after reading %d pages of bss", rss,
+          SIZE / 4096);
+  msg ("bss read without frames of its own");
+
+  msg ("write pass");
+  for (i = 0; i < SIZE; i += STRIDE)
+    buf[i] = expected (i);
+  if (resident () > rss + SIZE / STRIDE)
+    fail ("%lld frames mapped after writing %d pages of bss", resident (),
+          SIZE / STRIDE);
+  msg ("only the pages written got frames");
+
+  msg ("read pass after write");
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != expected (i))
+      fail ("byte %zu is %d, expected %d", i, buf[i], expected (i));
+}
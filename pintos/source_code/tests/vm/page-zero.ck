@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-zero) begin
+(page-zero) read pass
+(page-zero) bss read without frames of its own
+(page-zero) write pass
+(page-zero) only the pages written got frames
+(page-zero) read pass after write
+(page-zero) end
+EOF
+pass;
@@ -0,0 +1,57 @@
+/* Runs a small, latency-sensitive working set in this process
+   while a child process streams through much more memory than
+   there is, under a resident set limit set for it at exec.  Counts
+   the page faults this process takes after warming up, which the
+   limit and working set protection should keep low. */
+
+#include <syscall.h>
+#include <vmstat.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define HOT_PAGES 32
+#define HOG_LIMIT 128
+#define ROUNDS 200
+
+static char hot[HOT_PAGES * 4096];
+
+/* Returns the number of page faults taken by this process. */
+static long long
+fault_cnt (void)
+{
+  struct fault_stats st;
+  long long cnt = 0;
+  int c;
+
+  faultstat (&st, NULL, NULL);
+  for (c = 0; c < FAULT_CLASS_CNT; c++)
+    cnt += st.count[c];
+  return cnt;
+}
+
+void
+test_main (void)
+{
+  long long faults;
+  pid_t hog;
+  int round, i;
+
+  for (i = 0; i < HOT_PAGES; i++)
+    hot[i * 4096] = 1;
+
+  rsslimit (HOG_LIMIT);
+  CHECK ((hog = exec ("child-hog")) != PID_ERROR, "exec \"child-hog\"");
+  rsslimit (0);
+
+  faults = fault_cnt ();
+  for (round = 0; round < ROUNDS; round++)
+    for (i = 0; i < HOT_PAGES; i++)
+      hot[i * 4096]++;
+  faults = fault_cnt () - faults;
+
+  for (i = 0; i < HOT_PAGES; i++)
+    if (hot[i * 4096] != (char) (1 + ROUNDS))
+      fail ("hot page %d is wrong", i);
+  CHECK (wait (hog) == 0, "wait for child-hog");
+  msg ("interactive process: %lld faults in %d rounds", faults, ROUNDS);
+}
@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+
+# The fault count depends on timing; only check that it is there.
+my (@faults) = grep (/: \d+ faults in \d+ rounds$/, @output);
+fail "missing fault count in output\n" if @faults != 1;
+@output = grep (!/: \d+ faults in \d+ rounds$/, @output);
+
+compare_output ("run", IGNORE_EXIT_CODES => 1, \@output, [<<'EOF']);
+(rss-hog) begin
+(rss-hog) exec "child-hog"
+(rss-hog) wait for child-hog
+(rss-hog) end
+EOF
+pass;
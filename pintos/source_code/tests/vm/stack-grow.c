@@ -0,0 +1,47 @@
+/* Grows the stack down by 64 pages, one page after another, as deep
+   recursion does, and checks that the kernel maps the stack ahead
+   of the faults, taking far fewer faults than pages, and that every
+   page keeps what was written to it. */
+
+#include <syscall.h>
+#include <vmstat.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGES 64
+
+/* Returns the stack growth faults taken by this process. */
+static long long
+stack_faults (void)
+{
+  struct fault_stats st;
+
+  faultstat (&st, NULL, NULL);
+  return st.count[FAULT_STACK];
+}
+
+static void
+grow (void)
+{
+  char obj[PAGES * PAGE_SIZE];
+  long long before = stack_faults ();
+  int i;
+
+  for (i = PAGES - 1; i >= 0; i--)
+    obj[i * PAGE_SIZE] = i;
+  if (stack_faults () - before >= PAGES / 4)
+    fail ("%lld faults to grow the stack by %d pages",
+          stack_faults () - before, PAGES);
+  msg ("stack grown by %d pages", PAGES);
+
+  for (i = 0; i < PAGES; i++)
+    if (obj[i * PAGE_SIZE] != i)
+      fail ("stack page %d reads %d", i, obj[i * PAGE_SIZE]);
+}
+
+void
+test_main (void)
+{
+  grow ();
+}
@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(stack-grow) begin
+(stack-grow) stack grown by 64 pages
+(stack-grow) end
+EOF
+pass;
@@ -0,0 +1,35 @@
+/* Run with -stk=32: the kernel maps the top 32 pages of the stack
+   at exec.  Checks that writing to a stack object of 16 pages takes
+   no stack growth fault at all. */
+
+#include <syscall.h>
+#include <vmstat.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGES 16
+
+/* Returns the stack growth faults taken by this process. */
+static long long
+stack_faults (void)
+{
+  struct fault_stats st;
+
+  faultstat (&st, NULL, NULL);
+  return st.count[FAULT_STACK];
+}
+
+void
+test_main (void)
+{
+  char obj[PAGES * PAGE_SIZE];
+  int i;
+
+  for (i = 0; i < PAGES; i++)
+    obj[i * PAGE_SIZE] = i;
+  CHECK (stack_faults () == 0, "no stack faults for %d pages", PAGES);
+  for (i = 0; i < PAGES; i++)
+    if (obj[i * PAGE_SIZE] != i)
+      fail ("stack page %d reads %d", i, obj[i * PAGE_SIZE]);
+}
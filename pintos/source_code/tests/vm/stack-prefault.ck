@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(stack-prefault) begin
+(stack-prefault) no stack faults for 16 pages
+(stack-prefault) end
+EOF
+pass;
@@ -0,0 +1,64 @@
+/* Measures swap throughput: writes 3 MB of memory that does not
+   compress, more than fits in memory, so that most of it is
+   written to the swap disks, then reads it all back.  Run as
+   swap-bench-2 with two disks in -swap to see how striping
+   scales. */
+
+#include <stdint.h>
+#include <syscall.h>
+#include <vmstat.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGES 768
+#define WORDS (4096 / sizeof (uint32_t))
+
+static uint32_t buf[PAGES][WORDS];
+
+static inline uint64_t
+rdtsc (void)
+{
+  uint32_t lo, hi;
+  asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((uint64_t) hi << 32) | lo;
+}
+
+/* Returns word I of page P, different for every word so that the
+   pages do not compress. */
+static uint32_t
+pattern (int p, int i)
+{
+  uint32_t x = p * WORDS + i + 1;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return x * 2654435761u;
+}
+
+void
+test_main (void)
+{
+  struct swap_stats st;
+  uint64_t start, out_cycles, in_cycles;
+  int p, i;
+
+  start = rdtsc ();
+  for (p = 0; p < PAGES; p++)
+    for (i = 0; i < (int) WORDS; i++)
+      buf[p][i] = pattern (p, i);
+  out_cycles = (rdtsc () - start) / PAGES;
+
+  swapstat (&st, NULL);
+  if (st.pages == 0)
+    fail ("nothing was swapped out");
+
+  start = rdtsc ();
+  for (p = 0; p < PAGES; p++)
+    for (i = 0; i < (int) WORDS; i++)
+      if (buf[p][i] != pattern (p, i))
+        fail ("page %d is wrong at word %d", p, i);
+  in_cycles = (rdtsc () - start) / PAGES;
+
+  msg ("swap out: %llu cycles per page", out_cycles);
+  msg ("swap in: %llu cycles per page", in_cycles);
+}
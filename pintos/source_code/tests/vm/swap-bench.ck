@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+
+# The timings vary from run to run; only check that both are there.
+my (@timing) = grep (/: \d+ cycles per page$/, @output);
+fail "missing timings in output\n" if @timing != 2;
+@output = grep (!/: \d+ cycles per page$/, @output);
+
+compare_output ("run", IGNORE_EXIT_CODES => 1, \@output, [<<'EOF']);
+(swap-bench) begin
+(swap-bench) end
+EOF
+pass;
@@ -0,0 +1,45 @@
+/* Runs child-swap, which pushes 2 MB through swap, more times in
+   a row than swap could hold if the slots of exited processes were
+   not freed, and then checks that the system is back to the swap
+   use it started with, not counting this process's own. */
+
+#include <syscall.h>
+#include <vmstat.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHILD_CNT 8
+
+void
+test_main (void)
+{
+  struct swap_stats own, before, after;
+  long long pages, reserved;
+  int i;
+
+  swapstat (&own, &before);
+  pages = before.pages - own.pages;
+  reserved = before.reserved - own.reserved;
+  for (i = 0; i < CHILD_CNT; i++)
+    {
+      pid_t child = exec ("child-swap");
+      if (child == PID_ERROR)
+        fail ("exec \"child-swap\" %d failed", i);
+      if (wait (child) != 0)
+        fail ("child %d failed", i);
+    }
+  msg ("ran %d children", CHILD_CNT);
+
+  /* The last child's pages are freed by the reaper, which may not
+     be done yet. */
+  for (i = 0; i < 100000; i++)
+    {
+      swapstat (&own, &after);
+      if (after.pages - own.pages <= pages
+          && after.reserved - own.reserved <= reserved)
+        break;
+    }
+  CHECK (after.pages - own.pages <= pages, "swap slots freed");
+  CHECK (after.reserved - own.reserved <= reserved,
+         "swap reservations given back");
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(swap-reclaim) begin
+(swap-reclaim) ran 8 children
+(swap-reclaim) swap slots freed
+(swap-reclaim) swap reservations given back
+(swap-reclaim) end
+EOF
+pass;
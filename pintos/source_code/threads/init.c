@@ -25,8 +25,12 @@
 #include "userprog/process.h"
 #include "userprog/exception.h"
 #include "userprog/gdt.h"
+#include "userprog/pagedir.h"
 #include "userprog/syscall.h"
 #include "userprog/tss.h"
+#include "vm/frame.h"
+#include "vm/oom.h"
+#include "vm/swap.h"
 #else
 #include "tests/threads/tests.h"
 #endif
@@ -42,6 +46,16 @@ size_t ram_pages;
 /* Page directory with kernel mappings only. */
 uint32_t *base_page_dir;
 
+/* Page size extension is on: PDEs can map 4 MB pages. */
+bool large_pages;
+
+/* CPUID function 1 EDX bits and CR4 bits for page size extension
+   and global pages. */
+#define CPUID_PSE (1u << 3)
+#define CPUID_PGE (1u << 13)
+#define CR4_PSE (1u << 4)
+#define CR4_PGE (1u << 7)
+
 #ifdef FILESYS
 /* -f: Format the file system? */
 static bool format_filesys;
@@ -92,6 +106,7 @@ main (void)
   malloc_init ();
   paging_init ();
   frame_table_init ();
+  page_init ();
   /* Segmentation. */
 #ifdef USERPROG
   tss_init ();
@@ -119,6 +134,8 @@ main (void)
   filesys_init (format_filesys);
 #endif
   swap_init ();
+  pageout_start ();
+  process_reaper_start ();
   printf ("Boot complete.\n");
   
   /* Run actions specified on kernel command line. */
@@ -158,14 +175,24 @@ ram_init (void)
    At the time this function is called, the active page table
    (set up by loader.S) only maps the first 4 MB of RAM, so we
    should not try to use extravagant amounts of memory.
-   Fortunately, there is no need to do so. */
+   Fortunately, there is no need to do so.
+
+   If the CPU supports global pages, the kernel mapping, which is
+   the same in every page directory, is marked global, so that its
+   TLB entries survive the CR3 reload of a process switch.  See
+   [IA32-v3a] 3.11 "Translation Lookaside Buffers (TLBs)". */
 static void
 paging_init (void)
 {
   uint32_t *pd, *pt;
+  uint32_t cpuid, ebx, ecx, edx, cr4, global;
   size_t page;
   extern char _start, _end_kernel_text;
 
+  cpuid = 1;
+  asm ("cpuid" : "+a" (cpuid), "=b" (ebx), "=c" (ecx), "=d" (edx));
+  global = edx & CPUID_PGE ? PTE_G : 0;
+
   pd = base_page_dir = palloc_get_page (PAL_ASSERT | PAL_ZERO);
   pt = NULL;
   for (page = 0; page < ram_pages; page++) 
@@ -182,7 +209,7 @@ paging_init (void)
           pd[pde_idx] = pde_create (pt);
         }
 
-      pt[pte_idx] = pte_create_kernel (vaddr, !in_kernel_text);
+      pt[pte_idx] = pte_create_kernel (vaddr, !in_kernel_text) | global;
     }
 
   /* Store the physical address of the page directory into CR3
@@ -191,6 +218,20 @@ paging_init (void)
      to/from Control Registers" and [IA32-v3a] 3.7.5 "Base Address
      of the Page Directory". */
   asm volatile ("movl %0, %%cr3" : : "r" (vtop (base_page_dir)));
+
+  /* Turn on global pages, and page size extension, so that large
+     user regions can be mapped with 4 MB pages, if the CPU has
+     them.  See [IA32-v3a] 3.7.3 "Mixing 4-KByte and 4-MByte
+     Pages". */
+  asm volatile ("movl %%cr4, %0" : "=r" (cr4));
+  if (global)
+    cr4 |= CR4_PGE;
+  if (edx & CPUID_PSE)
+    {
+      cr4 |= CR4_PSE;
+      large_pages = true;
+    }
+  asm volatile ("movl %0, %%cr4" : : "r" (cr4));
 }
 
 /* Breaks the kernel command line into words and returns them as
@@ -256,7 +297,25 @@ parse_options (char **argv)
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
+      else if (!strcmp (name, "-stk"))
+        stack_exec_pages = atoi (value);
 #endif
+      else if (!strcmp (name, "-rp"))
+        {
+          if (value != NULL && !strcmp (value, "clock"))
+            frame_policy = POLICY_CLOCK;
+          else if (value != NULL && !strcmp (value, "2q"))
+            frame_policy = POLICY_2Q;
+          else
+            PANIC ("unknown replacement policy `%s' (use -h for help)",
+                   value != NULL ? value : "");
+        }
+      else if (!strcmp (name, "-merge"))
+        frame_merge = true;
+      else if (!strcmp (name, "-swap"))
+        swap_configure (value);
+      else if (!strcmp (name, "-overcommit"))
+        swap_overcommit = true;
       else
         PANIC ("unknown option `%s' (use -h for help)", name);
     }
@@ -381,7 +440,14 @@ usage (void)
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
+          "  -stk=COUNT         Map COUNT stack pages when a program starts.\n"
 #endif
+          "  -rp=POLICY         Replace pages by POLICY, clock or 2q.\n"
+          "  -merge             Merge user pages with the same contents.\n"
+          "  -swap=CHAN:DEV[:PRIO],...\n"
+          "                     Swap to these disks, higher PRIO first,\n"
+          "                     striping over disks of equal PRIO.\n"
+          "  -overcommit        Create pages even if swap may not hold them.\n"
           );
   power_off ();
 }
@@ -458,5 +524,11 @@ print_stats (void)
   kbd_print_stats ();
 #ifdef USERPROG
   exception_print_stats ();
+  pagedir_print_stats ();
+  process_print_stats ();
+  frame_print_stats ();
+  page_print_stats ();
+  swap_print_stats ();
+  oom_print_stats ();
 #endif
 }
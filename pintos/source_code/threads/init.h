@@ -12,6 +12,9 @@ extern size_t ram_pages;
 /* Page directory with kernel mappings only. */
 extern uint32_t *base_page_dir;
 
+/* Can user pages be mapped with 4 MB pages?  See paging_init(). */
+extern bool large_pages;
+
 /* -q: Power off when kernel tasks complete? */
 extern bool power_off_when_done;
 
@@ -51,7 +51,9 @@ static inline uintptr_t pd_no (const void *va) {
    |         Physical Address           |         Flags          |
    +------------------------------------+------------------------+
 
-   In a PDE, the physical address points to a page table.
+   In a PDE, the physical address points to a page table, unless
+   PTE_PS is set: then bits 22:31 are the address of a 4 MB page,
+   PTSPAN bytes, which the PDE maps on its own.
    In a PTE, the physical address points to a data or code page.
    The important flags are listed below.
    When a PDE or PTE is not "present", the other flags are
@@ -66,6 +68,12 @@ static inline uintptr_t pd_no (const void *va) {
 #define PTE_U 0x4               /* 1=user/kernel, 0=kernel only. */
 #define PTE_A 0x20              /* 1=accessed, 0=not acccessed. */
 #define PTE_D 0x40              /* 1=dirty, 0=not dirty (PTEs only). */
+#define PTE_PS 0x80             /* 1=maps a 4 MB page (PDEs only). */
+#define PTE_G 0x100             /* 1=global, kept in the TLB on CR3 load. */
+
+/* OS use of not-present PTEs, see userprog/pagedir.c. */
+#define PTE_SWAP 0x200          /* Page is in the swap slot in PTE_ADDR. */
+#define PTE_FILE 0x400          /* Page was dropped, read it from its file. */
 
 /* Returns a PDE that points to page table PT. */
 static inline uint32_t pde_create (uint32_t *pt) {
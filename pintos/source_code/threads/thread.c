@@ -629,10 +629,19 @@ static void init_thread (struct thread *t, const char *name, int priority)
 
   if (t != initial_thread)
     supp_page_table_init (&t->supp_page_table);
+  t->vma_root = NULL;
+  t->ra_next = NULL;
+  t->ra_window = 0;
+  t->stack_chunk = 0;
 
   list_init (&t->children);
+  list_init (&t->cold_sptes);
   sema_init (&t->sema_ready, 0);
   sema_init (&t->sema_terminated, 0);
+  t->reap_queued = false;
+  sema_init (&t->sema_reaped, 0);
+  t->reap_inode = NULL;
+  t->oom_killed = false;
   t->return_status = -1;
   t->load_complete = false;
   sema_init (&t->sema_ack, 0);
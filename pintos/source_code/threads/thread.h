@@ -5,6 +5,7 @@
 #include <list.h>
 #include "threads/synch.h"
 #include <stdint.h>
+#include <vmstat.h>
 #include "vm/page.h"
 
 /* States in a thread's life cycle. */
@@ -113,11 +114,37 @@ struct thread
     struct list children;               
     struct file *executable_file;
     struct file *files[MAX_FILES];
-    struct spt_entry *mmap_files[MAX_FILES];
+    struct vma *mmap_files[MAX_FILES];
+    struct vma *vma_root;               /* Address space regions. */
 
     struct hash supp_page_table;
+    struct list cold_sptes;             /* Entries of evicted pages, to be
+                                           freed; see page_free_cold(). */
+    void *ra_next;                      /* Page expected to fault next. */
+    int ra_window;                      /* Pages to read ahead. */
+    int stack_chunk;                    /* Pages to grow the stack by. */
+    struct fault_stats fault_stats;     /* Page faults of this process. */
+
+    /* Resident set, protected by the frame table lock.  A frame
+       shared by several processes counts for each of them. */
+    size_t rss;                         /* Frames mapped. */
+    size_t rss_limit;                   /* Most frames to map, or 0. */
+    size_t exec_rss_limit;              /* RSS_LIMIT of processes exec'd. */
+    size_t wss;                         /* Working set estimate. */
+    size_t ws_sample;                   /* Frames accessed this interval. */
+    size_t swap_reserved;               /* Anonymous pages, which swap is
+                                           reserved for; see
+                                           swap_reserve(). */
+    size_t swap_cnt;                    /* Swap entries in the page table,
+                                           under the swap lock. */
     struct semaphore sema_ready;
     struct semaphore sema_terminated;
+    struct list_elem reap_elem;         /* Element in the reaper's queue. */
+    bool reap_queued;                   /* Address space left to the reaper. */
+    struct semaphore sema_reaped;       /* Upped once the reaper is done. */
+    struct inode *reap_inode;           /* Executable, for the reaper to close. */
+    bool oom_killed;                    /* Killed for lack of memory. */
+    int64_t oom_kill_tick;              /* When it was killed. */
     int return_status;
     bool load_complete;
     struct semaphore sema_ack;
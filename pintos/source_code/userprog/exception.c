@@ -12,6 +12,20 @@
 /* Number of page faults processed. */
 static long long page_fault_cnt;
 
+/* User page faults of every process, by class, and their latency.
+   They are updated without a lock, like page_fault_cnt, so a
+   count may rarely miss an update made by a preempted thread. */
+static struct fault_stats fault_stats;
+static struct fault_hist fault_hist;
+
+/* Names of the fault classes, for printing. */
+static const char *fault_class_names[FAULT_CLASS_CNT] =
+  { "file", "mmap", "swap", "anon", "stack", "cow" };
+
+static void record_fault (enum fault_class, uint64_t cycles);
+static void record_latency (long long *hist, uint64_t cycles);
+static uint64_t latency_percentile (const long long *hist, int pct);
+
 static void kill (struct intr_frame *);
 static void page_fault (struct intr_frame *);
 
@@ -65,7 +79,99 @@ exception_init (void)
 void
 exception_print_stats (void) 
 {
+  int c;
+
   printf ("Exception: %lld page faults\n", page_fault_cnt);
+  for (c = 0; c < FAULT_CLASS_CNT; c++)
+    if (fault_stats.count[c] > 0)
+      printf ("Exception: %lld %s faults, %lld cycles each\n",
+              fault_stats.count[c], fault_class_names[c],
+              fault_stats.cycles[c] / fault_stats.count[c]);
+  if (fault_stats.evict_cnt > 0)
+    printf ("Exception: %lld evictions on fault, %lld cycles each, "
+            "p99 < %"PRIu64" cycles\n",
+            fault_stats.evict_cnt,
+            fault_stats.evict_cycles / fault_stats.evict_cnt,
+            latency_percentile (fault_hist.evict, 99));
+  printf ("Exception: fault latency p50 < %"PRIu64", p90 < %"PRIu64
+          ", p99 < %"PRIu64" cycles\n",
+          latency_percentile (fault_hist.load, 50),
+          latency_percentile (fault_hist.load, 90),
+          latency_percentile (fault_hist.load, 99));
+}
+
+/* Counts an eviction that took CYCLES, made by the current thread
+   to get a frame, usually on a page fault. */
+void
+exception_record_evict (uint64_t cycles)
+{
+  struct thread *t = thread_current ();
+
+  t->fault_stats.evict_cnt++;
+  t->fault_stats.evict_cycles += cycles;
+  fault_stats.evict_cnt++;
+  fault_stats.evict_cycles += cycles;
+  record_latency (fault_hist.evict, cycles);
+}
+
+/* Returns the system-wide fault statistics. */
+const struct fault_stats *
+exception_fault_stats (void)
+{
+  return &fault_stats;
+}
+
+/* Returns the system-wide fault latency histograms. */
+const struct fault_hist *
+exception_fault_hist (void)
+{
+  return &fault_hist;
+}
+
+/* Counts a fault of class CLASS that took CYCLES to handle. */
+static void
+record_fault (enum fault_class class, uint64_t cycles)
+{
+  struct thread *t = thread_current ();
+
+  t->fault_stats.count[class]++;
+  t->fault_stats.cycles[class] += cycles;
+  fault_stats.count[class]++;
+  fault_stats.cycles[class] += cycles;
+  record_latency (fault_hist.load, cycles);
+}
+
+/* Adds an event that took CYCLES to histogram HIST. */
+static void
+record_latency (long long *hist, uint64_t cycles)
+{
+  int bucket = 0;
+  while (cycles > 1 && bucket < FAULT_LAT_BUCKETS - 1)
+    {
+      cycles >>= 1;
+      bucket++;
+    }
+  hist[bucket]++;
+}
+
+/* Returns an upper bound, in cycles, on the latency of PCT
+   percent of the events in histogram HIST. */
+static uint64_t
+latency_percentile (const long long *hist, int pct)
+{
+  long long total = 0, target, seen = 0;
+  int bucket;
+
+  for (bucket = 0; bucket < FAULT_LAT_BUCKETS; bucket++)
+    total += hist[bucket];
+  target = (total * pct + 99) / 100;
+  for (bucket = 0; bucket < FAULT_LAT_BUCKETS - 1; bucket++)
+    {
+      seen += hist[bucket];
+      if (seen >= target)
+        break;
+    }
+  return (uint64_t) 2 << bucket;
 }
 
 /* Handler for an exception (probably) caused by a user process. */
@@ -149,6 +255,8 @@ page_fault (struct intr_frame *f)
   user = (f->error_code & PF_U) != 0;
 
   bool loaded = false;
+  enum fault_class class = FAULT_COW;
+  uint64_t start = rdtsc ();
 
   /* if this is a user page then load else dont do anything*/
   if (user)
@@ -156,25 +264,46 @@ page_fault (struct intr_frame *f)
     if (!is_user_vaddr (fault_addr) || fault_addr == NULL)
       exit (NULL);
 
+    /* Killed for lack of memory. */
+    if (thread_current ()->oom_killed)
+      exit (NULL);
+    page_free_cold ();
+
     // In case the page isn't present //
     if (not_present)
     {
       struct spt_entry *spte = uvaddr_to_spt_entry (fault_addr);
 
-      if (spte != NULL && install_load_page (spte))
-        loaded = true;
+      if (spte != NULL)
+      {
+        class = page_fault_class (spte);
+        loaded = write ? install_load_page (spte)
+                       : install_load_page_read (spte);
+      }
       else if (fault_addr >= f->esp - STACK_HEURISTIC &&
-               stack_increase (fault_addr,false,NULL))
+               stack_increase (fault_addr, write))
+      {
+        class = FAULT_STACK;
         loaded = true;
+      }
 
       if (!loaded)
         exit (NULL);
+      record_fault (class, rdtsc () - start);
     }
     else
     {
       struct spt_entry *spte = uvaddr_to_spt_entry (fault_addr);
-      if (write && !spte->writable)
+      if (spte == NULL || (write && !spte->writable))
         exit (NULL);
+
+      /* First write to a page mapped to the shared zero page, or
+         to a page fork() left shared and read-only. */
+      if (write && install_load_page (spte))
+      {
+        loaded = true;
+        record_fault (class, rdtsc () - start);
+      }
     }
   }
 	
@@ -6,7 +6,22 @@
 #define PF_W 0x2    /* 0: read, 1: write. */
 #define PF_U 0x4    /* 0: kernel, 1: user process. */
 
+#include <stdint.h>
+#include <vmstat.h>
+
 void exception_init (void);
 void exception_print_stats (void);
+void exception_record_evict (uint64_t cycles);
+const struct fault_stats *exception_fault_stats (void);
+const struct fault_hist *exception_fault_hist (void);
+
+/* Reads the CPU's time-stamp counter. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint32_t lo, hi;
+  asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((uint64_t) hi << 32) | lo;
+}
 
 #endif /* userprog/exception.h */
@@ -1,13 +1,39 @@
 #include "userprog/pagedir.h"
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdio.h>
 #include <string.h>
 #include "threads/init.h"
 #include "threads/pte.h"
 #include "threads/palloc.h"
+#include "threads/thread.h"
 
 static uint32_t *active_pd (void);
+static void load_pd (uint32_t *);
 static void invalidate_pagedir (uint32_t *);
+static void invalidate_page (uint32_t *, const void *);
+static void pagedir_batch_add (uint32_t *, const void *);
+static uint32_t *lookup_large (uint32_t *, const void *);
+static void split_large_page (uint32_t *, uint32_t *);
+
+/* Large pages split back into page tables. */
+static long long split_cnt;
+
+/* Batched invalidation: while BATCH_OWNER runs a batch, the TLB
+   entries it would invalidate in the active page directory are
+   noted in BATCH_PAGES instead, up to BATCH_MAX of them, and
+   BATCH_CNT counts them all. */
+#define BATCH_MAX 16
+static struct thread *batch_owner;
+static const void *batch_pages[BATCH_MAX];
+static size_t batch_cnt;
+
+/* TLB statistics. */
+static long long cr3_load_cnt;      /* Page directories loaded. */
+static long long cr3_skip_cnt;      /* Loads avoided, PD already active. */
+static long long invlpg_cnt;        /* Single entries invalidated. */
+static long long flush_cnt;         /* Whole TLB flushes. */
+static long long batched_cnt;       /* Invalidations put off in a batch. */
 
 /* Creates a new page directory that has mappings for kernel
    virtual addresses, but none for user virtual addresses.
@@ -33,8 +59,16 @@ pagedir_destroy (uint32_t *pd)
     return;
 
   ASSERT (pd != base_page_dir);
+
+  /* A kernel thread may still be running on PD; see
+     pagedir_activate(). */
+  if (active_pd () == pd)
+    pagedir_activate (NULL);
+
   for (pde = pd; pde < pd + pd_no (PHYS_BASE); pde++)
-    if (*pde & PTE_P) 
+    if (*pde & PTE_PS)
+      palloc_free_multiple (ptov (*pde & PDMASK), PTSPAN / PGSIZE);
+    else if (*pde & PTE_P) 
       {
         uint32_t *pt = pde_get_pt (*pde);
         uint32_t *pte;
@@ -52,7 +86,9 @@ pagedir_destroy (uint32_t *pd)
    If PD does not have a page table for VADDR, behavior depends
    on CREATE.  If CREATE is true, then a new page table is
    created and a pointer into it is returned.  Otherwise, a null
-   pointer is returned. */
+   pointer is returned.
+   A large page mapping VADDR is split first, since the caller is
+   going to look at or change a single page. */
 static uint32_t *
 lookup_page (uint32_t *pd, const void *vaddr, bool create)
 {
@@ -66,6 +102,8 @@ lookup_page (uint32_t *pd, const void *vaddr, bool create)
   /* Check for a page table for VADDR.
      If one is missing, create one if requested. */
   pde = pd + pd_no (vaddr);
+  if (*pde & PTE_PS)
+    split_large_page (pd, pde);
   if (*pde == 0) 
     {
       if (create)
@@ -128,6 +166,10 @@ pagedir_get_page (uint32_t *pd, const void *uaddr)
   uint32_t *pte;
 
   ASSERT (is_user_vaddr (uaddr));
+
+  pte = lookup_large (pd, uaddr);
+  if (pte != NULL)
+    return ptov (*pte & PDMASK) + ((uintptr_t) uaddr & (PTSPAN - 1));
   
   pte = lookup_page (pd, uaddr, false);
   if (pte != NULL && (*pte & PTE_P) != 0)
@@ -152,10 +194,120 @@ pagedir_clear_page (uint32_t *pd, void *upage)
   if (pte != NULL && (*pte & PTE_P) != 0)
     {
       *pte &= ~PTE_P;
-      invalidate_pagedir (pd);
+      invalidate_page (pd, upage);
+    }
+}
+
+/* A page that is not present can still have a PTE telling where
+   it is, so that a fault on it need not look anywhere else.  A
+   swap entry holds PTE_SWAP and, in place of the frame address, the
+   number of the swap slot the page was written to.  A file entry
+   holds only PTE_FILE: the page was dropped from memory and is to
+   be read from its file again.  Neither has PTE_P set, so the CPU
+   ignores them. */
+
+/* Replaces the not-present PTE for user page UPAGE in PD by a swap
+   entry for swap slot SLOT, creating a page table if needed.
+   Returns false if memory for the page table cannot be
+   obtained. */
+bool
+pagedir_set_swap (uint32_t *pd, void *upage, size_t slot) 
+{
+  uint32_t *pte;
+
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (is_user_vaddr (upage));
+  ASSERT (slot < (PTE_ADDR >> PGBITS) + 1);
+
+  pte = lookup_page (pd, upage, true);
+  if (pte == NULL)
+    return false;
+  ASSERT ((*pte & PTE_P) == 0);
+  *pte = (slot << PGBITS) | PTE_SWAP;
+  return true;
+}
+
+/* If the PTE for user page UPAGE in PD is a swap entry, stores its
+   swap slot in *SLOT and returns true.  Returns false otherwise. */
+bool
+pagedir_get_swap (uint32_t *pd, const void *upage, size_t *slot) 
+{
+  if (lookup_large (pd, upage) != NULL)
+    return false;
+
+  uint32_t *pte = lookup_page (pd, upage, false);
+  if (pte == NULL || (*pte & (PTE_P | PTE_SWAP)) != PTE_SWAP)
+    return false;
+  *slot = *pte >> PGBITS;
+  return true;
+}
+
+/* Calls FN for every swap entry in PD, with the user page, its
+   swap slot and AUX, until FN returns false.  Returns false if FN
+   did. */
+bool
+pagedir_for_each_swap (uint32_t *pd,
+                       bool (*fn) (void *upage, size_t slot, void *aux),
+                       void *aux) 
+{
+  uint32_t *pde;
+
+  for (pde = pd; pde < pd + pd_no (PHYS_BASE); pde++)
+    if ((*pde & (PTE_P | PTE_PS)) == PTE_P) 
+      {
+        uint32_t *pt = pde_get_pt (*pde);
+        uint32_t *pte;
+
+        for (pte = pt; pte < pt + PGSIZE / sizeof *pte; pte++)
+          if ((*pte & (PTE_P | PTE_SWAP)) == PTE_SWAP)
+            {
+              void *upage = (void *) (((pde - pd) << PDSHIFT)
+                                      | ((pte - pt) << PTSHIFT));
+              if (!fn (upage, *pte >> PGBITS, aux))
+                return false;
+            }
+      }
+  return true;
+}
+
+/* Clears the swap entry for user page UPAGE in PD, if there is
+   one. */
+void
+pagedir_clear_swap (uint32_t *pd, void *upage) 
+{
+  if (lookup_large (pd, upage) != NULL)
+    return;
+
+  uint32_t *pte = lookup_page (pd, upage, false);
+  if (pte != NULL && (*pte & (PTE_P | PTE_SWAP)) == PTE_SWAP)
+    *pte = 0;
+}
+
+/* Replaces the not-present PTE for user page UPAGE in PD, if there
+   is one, by a file entry. */
+void
+pagedir_set_file (uint32_t *pd, void *upage) 
+{
+  uint32_t *pte = lookup_page (pd, upage, false);
+  if (pte != NULL)
+    {
+      ASSERT ((*pte & PTE_P) == 0);
+      *pte = PTE_FILE;
     }
 }
 
+/* Returns true if the PTE for user page UPAGE in PD is a file
+   entry. */
+bool
+pagedir_is_file (uint32_t *pd, const void *upage) 
+{
+  if (lookup_large (pd, upage) != NULL)
+    return false;
+
+  uint32_t *pte = lookup_page (pd, upage, false);
+  return pte != NULL && (*pte & (PTE_P | PTE_FILE)) == PTE_FILE;
+}
+
 /* Returns true if the PTE for virtual page VPAGE in PD is dirty,
    that is, if the page has been modified since the PTE was
    installed.
@@ -163,7 +315,9 @@ pagedir_clear_page (uint32_t *pd, void *upage)
 bool
 pagedir_is_dirty (uint32_t *pd, const void *vpage) 
 {
-  uint32_t *pte = lookup_page (pd, vpage, false);
+  uint32_t *pte = lookup_large (pd, vpage);
+  if (pte == NULL)
+    pte = lookup_page (pd, vpage, false);
   return pte != NULL && (*pte & PTE_D) != 0;
 }
 
@@ -180,11 +334,38 @@ pagedir_set_dirty (uint32_t *pd, const void *vpage, bool dirty)
       else 
         {
           *pte &= ~(uint32_t) PTE_D;
-          invalidate_pagedir (pd);
+          invalidate_page (pd, vpage);
         }
     }
 }
 
+/* Returns true if the PTE for virtual page VPAGE in PD allows
+   writes.  Returns false if PD contains no PTE for VPAGE. */
+bool
+pagedir_is_writable (uint32_t *pd, const void *vpage) 
+{
+  uint32_t *pte = lookup_large (pd, vpage);
+  if (pte == NULL)
+    pte = lookup_page (pd, vpage, false);
+  return pte != NULL && (*pte & PTE_W) != 0;
+}
+
+/* Sets the writable bit to WRITABLE in the PTE for virtual page
+   VPAGE in PD, keeping the rest of the PTE as it is. */
+void
+pagedir_set_writable (uint32_t *pd, const void *vpage, bool writable) 
+{
+  uint32_t *pte = lookup_page (pd, vpage, false);
+  if (pte != NULL) 
+    {
+      if (writable)
+        *pte |= PTE_W;
+      else
+        *pte &= ~(uint32_t) PTE_W;
+      invalidate_page (pd, vpage);
+    }
+}
+
 /* Returns true if the PTE for virtual page VPAGE in PD has been
    accessed recently, that is, between the time the PTE was
    installed and the last time it was cleared.  Returns false if
@@ -192,16 +373,22 @@ pagedir_set_dirty (uint32_t *pd, const void *vpage, bool dirty)
 bool
 pagedir_is_accessed (uint32_t *pd, const void *vpage) 
 {
-  uint32_t *pte = lookup_page (pd, vpage, false);
+  uint32_t *pte = lookup_large (pd, vpage);
+  if (pte == NULL)
+    pte = lookup_page (pd, vpage, false);
   return pte != NULL && (*pte & PTE_A) != 0;
 }
 
 /* Sets the accessed bit to ACCESSED in the PTE for virtual page
-   VPAGE in PD. */
+   VPAGE in PD.  A large page has one accessed bit for all its
+   pages, which this sets or clears without splitting it.  Clearing
+   the bit can be batched; see pagedir_batch_begin(). */
 void
 pagedir_set_accessed (uint32_t *pd, const void *vpage, bool accessed) 
 {
-  uint32_t *pte = lookup_page (pd, vpage, false);
+  uint32_t *pte = lookup_large (pd, vpage);
+  if (pte == NULL)
+    pte = lookup_page (pd, vpage, false);
   if (pte != NULL) 
     {
       if (accessed)
@@ -209,25 +396,202 @@ pagedir_set_accessed (uint32_t *pd, const void *vpage, bool accessed)
       else 
         {
           *pte &= ~(uint32_t) PTE_A; 
-          invalidate_pagedir (pd);
+          pagedir_batch_add (pd, vpage);
         }
     }
 }
 
+/* Large pages.  A PDE with PTE_PS set maps a whole aligned 4 MB
+   block of physical memory, PTSPAN bytes, instead of pointing to a
+   page table, so that the block takes a single TLB entry instead of
+   1024.  User blocks are mapped this way only when all of their
+   pages are loaded at once; each frame is still managed on its
+   own.  Looking at the page's frame, or at its accessed and dirty
+   bits, which the large page holds for all the pages, works on the
+   large page as it is.  Anything that changes a single page, from
+   eviction to munmap() to copy-on-write, goes through lookup_page(),
+   which splits the large page into a page table of 4 kB pages
+   first. */
+
+/* Returns true if none of the pages of the PTSPAN aligned user
+   block BLOCK is mapped in PD, or has a swap or file entry, so
+   that the block can be mapped by a large page. */
+bool
+pagedir_block_unused (uint32_t *pd, const void *block)
+{
+  uint32_t *pde = pd + pd_no (block);
+  uint32_t *pt, *pte;
+
+  ASSERT (((uintptr_t) block & (PTSPAN - 1)) == 0);
+  ASSERT (is_user_vaddr (block));
+
+  if (*pde == 0)
+    return true;
+  if (*pde & PTE_PS)
+    return false;
+  pt = pde_get_pt (*pde);
+  for (pte = pt; pte < pt + PGSIZE / sizeof *pte; pte++)
+    if (*pte & (PTE_P | PTE_SWAP | PTE_FILE))
+      return false;
+  return true;
+}
+
+/* Maps the PTSPAN bytes at user address BLOCK in PD, which
+   pagedir_block_unused() must allow, to the physically contiguous
+   and aligned frames at KPAGE with a single large page, read/write
+   if WRITABLE.  The page table that was there, if any, is freed. */
+void
+pagedir_set_large_page (uint32_t *pd, void *block, void *kpage,
+                        bool writable)
+{
+  uint32_t *pde = pd + pd_no (block);
+
+  ASSERT (large_pages);
+  ASSERT (pagedir_block_unused (pd, block));
+  ASSERT ((vtop (kpage) & (PTSPAN - 1)) == 0);
+  ASSERT (pd != base_page_dir);
+
+  if (*pde != 0)
+    palloc_free_page (pde_get_pt (*pde));
+  *pde = vtop (kpage) | PTE_PS | PTE_U | PTE_P | (writable ? PTE_W : 0);
+
+  /* The CPU may have cached the old PDE. */
+  invalidate_pagedir (pd);
+}
+
+/* Returns true if user address VADDR is mapped by a large page in
+   PD. */
+bool
+pagedir_is_large (uint32_t *pd, const void *vaddr)
+{
+  return lookup_large (pd, vaddr) != NULL;
+}
+
+/* Returns the number of large pages split into 4 kB pages. */
+long long
+pagedir_split_cnt (void)
+{
+  return split_cnt;
+}
+
+/* Returns the PDE of the large page mapping VADDR in PD, or a null
+   pointer if VADDR is not mapped by a large page. */
+static uint32_t *
+lookup_large (uint32_t *pd, const void *vaddr)
+{
+  uint32_t *pde = pd + pd_no (vaddr);
+  return *pde & PTE_PS ? pde : NULL;
+}
+
+/* Replaces large page PDE in PD by a page table that maps the same
+   frames with 4 kB pages.  Each page gets the large page's
+   accessed and dirty bits, which may have been set by any of
+   them.  The page table comes from the kernel pool, which is half
+   of memory, so running out of it here is treated as fatal, as it
+   is when the kernel runs out of it anywhere else. */
+static void
+split_large_page (uint32_t *pd, uint32_t *pde)
+{
+  uint32_t *pt = palloc_get_page (PAL_ASSERT);
+  uint32_t paddr = *pde & PDMASK;
+  uint32_t flags = *pde & PTE_FLAGS & ~(uint32_t) PTE_PS;
+  size_t i;
+
+  for (i = 0; i < PGSIZE / sizeof *pt; i++)
+    pt[i] = (paddr + i * PGSIZE) | flags;
+  *pde = pde_create (pt);
+  split_cnt++;
+
+  /* The TLB must not keep the large page and the new small pages
+     side by side.  See [IA32-v3a] 10.6 "Invalidating the TLBs". */
+  invalidate_pagedir (pd);
+}
+
 /* Loads page directory PD into the CPU's page directory base
-   register. */
+   register, unless it is already there.  Loading it flushes the
+   TLB, all but the global kernel entries, so switching between
+   threads of one process, or to a kernel thread, which runs on
+   whatever page directory is active, costs no TLB misses. */
 void
 pagedir_activate (uint32_t *pd) 
 {
   if (pd == NULL)
     pd = base_page_dir;
 
-  /* Store the physical address of the page directory into CR3
-     aka PDBR (page directory base register).  This activates our
-     new page tables immediately.  See [IA32-v2a] "MOV--Move
-     to/from Control Registers" and [IA32-v3a] 3.7.5 "Base
-     Address of the Page Directory". */
-  asm volatile ("movl %0, %%cr3" : : "r" (vtop (pd)) : "memory");
+  if (active_pd () == pd)
+    cr3_skip_cnt++;
+  else
+    {
+      load_pd (pd);
+      cr3_load_cnt++;
+    }
+}
+
+/* Starts a batch of invalidations, to be made by
+   pagedir_batch_end().  Only invalidations that are safe to put
+   off are batched: clearing an accessed bit, whose stale TLB entry
+   at worst keeps the CPU from setting the bit again on the next
+   access, so that the page looks colder than it is for a moment.
+   A sweep of the clock clears many accessed bits, and without a
+   batch would invalidate for each one.  Batches do not nest, and
+   are only run by one thread at a time; the frame table lock sees
+   to that. */
+void
+pagedir_batch_begin (void)
+{
+  ASSERT (batch_owner == NULL);
+  batch_owner = thread_current ();
+  batch_cnt = 0;
+}
+
+/* Ends the batch started by pagedir_batch_begin(), invalidating
+   the TLB entries it put off: one by one if there are few, or all
+   at once.  A process switch during the batch flushed them
+   already, but invalidating again does no harm. */
+void
+pagedir_batch_end (void)
+{
+  size_t i;
+
+  ASSERT (batch_owner == thread_current ());
+  batch_owner = NULL;
+  if (batch_cnt > BATCH_MAX)
+    {
+      load_pd (active_pd ());
+      flush_cnt++;
+    }
+  else
+    for (i = 0; i < batch_cnt; i++)
+      {
+        asm volatile ("invlpg (%0)" : : "r" (batch_pages[i]) : "memory");
+        invlpg_cnt++;
+      }
+  batched_cnt += batch_cnt;
+}
+
+/* Invalidates the TLB entry for VADDR in PD, or puts it off if the
+   current thread is running a batch.  Used only where putting it
+   off is safe; see pagedir_batch_begin(). */
+static void
+pagedir_batch_add (uint32_t *pd, const void *vaddr)
+{
+  if (batch_owner != thread_current () || active_pd () != pd)
+    invalidate_page (pd, vaddr);
+  else
+    {
+      if (batch_cnt < BATCH_MAX)
+        batch_pages[batch_cnt] = vaddr;
+      batch_cnt++;
+    }
+}
+
+/* Prints TLB statistics. */
+void
+pagedir_print_stats (void)
+{
+  printf ("TLB: %lld page directory loads, %lld skipped, "
+          "%lld entries invalidated, %lld flushes, %lld batched\n",
+          cr3_load_cnt, cr3_skip_cnt, invlpg_cnt, flush_cnt, batched_cnt);
 }
 
 /* Returns the currently active page directory. */
@@ -243,6 +607,18 @@ active_pd (void)
   return ptov (pd);
 }
 
+/* Stores the physical address of the page directory into CR3 aka
+   PDBR (page directory base register).  This activates our new
+   page tables immediately, and flushes the TLB of every entry
+   that is not global.  See [IA32-v2a] "MOV--Move to/from Control
+   Registers" and [IA32-v3a] 3.7.5 "Base Address of the Page
+   Directory". */
+static void
+load_pd (uint32_t *pd)
+{
+  asm volatile ("movl %0, %%cr3" : : "r" (vtop (pd)) : "memory");
+}
+
 /* Seom page table changes can cause the CPU's translation
    lookaside buffer (TLB) to become out-of-sync with the page
    table.  When this happens, we have to "invalidate" the TLB by
@@ -250,7 +626,8 @@ active_pd (void)
 
    This function invalidates the TLB if PD is the active page
    directory.  (If PD is not active then its entries are not in
-   the TLB, so there is no need to invalidate anything.) */
+   the TLB, so there is no need to invalidate anything.)  User
+   mappings are never global, so reloading PD drops all of them. */
 static void
 invalidate_pagedir (uint32_t *pd) 
 {
@@ -258,6 +635,20 @@ invalidate_pagedir (uint32_t *pd)
     {
       /* Re-activating PD clears the TLB.  See [IA32-v3a] 3.12
          "Translation Lookaside Buffers (TLBs)". */
-      pagedir_activate (pd);
+      load_pd (pd);
+      flush_cnt++;
     } 
 }
+
+/* Invalidates the TLB entry for VADDR alone, if PD is the active
+   page directory.  Used when a single PTE changes.  See [IA32-v2a]
+   "INVLPG--Invalidate TLB Entry". */
+static void
+invalidate_page (uint32_t *pd, const void *vaddr)
+{
+  if (active_pd () == pd)
+    {
+      asm volatile ("invlpg (%0)" : : "r" (vaddr) : "memory");
+      invlpg_cnt++;
+    }
+}
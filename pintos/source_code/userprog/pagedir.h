@@ -2,6 +2,7 @@
 #define USERPROG_PAGEDIR_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 uint32_t *pagedir_create (void);
@@ -9,10 +10,28 @@ void pagedir_destroy (uint32_t *pd);
 bool pagedir_set_page (uint32_t *pd, void *upage, void *kpage, bool rw);
 void *pagedir_get_page (uint32_t *pd, const void *upage);
 void pagedir_clear_page (uint32_t *pd, void *upage);
+bool pagedir_set_swap (uint32_t *pd, void *upage, size_t slot);
+bool pagedir_get_swap (uint32_t *pd, const void *upage, size_t *slot);
+bool pagedir_for_each_swap (uint32_t *pd,
+                            bool (*fn) (void *upage, size_t slot, void *aux),
+                            void *aux);
+void pagedir_clear_swap (uint32_t *pd, void *upage);
+void pagedir_set_file (uint32_t *pd, void *upage);
+bool pagedir_is_file (uint32_t *pd, const void *upage);
 bool pagedir_is_dirty (uint32_t *pd, const void *upage);
 void pagedir_set_dirty (uint32_t *pd, const void *upage, bool dirty);
+bool pagedir_is_writable (uint32_t *pd, const void *upage);
+void pagedir_set_writable (uint32_t *pd, const void *upage, bool writable);
 bool pagedir_is_accessed (uint32_t *pd, const void *upage);
 void pagedir_set_accessed (uint32_t *pd, const void *upage, bool accessed);
+bool pagedir_block_unused (uint32_t *pd, const void *block);
+void pagedir_set_large_page (uint32_t *pd, void *block, void *kpage,
+                             bool writable);
+bool pagedir_is_large (uint32_t *pd, const void *vaddr);
+long long pagedir_split_cnt (void);
 void pagedir_activate (uint32_t *pd);
+void pagedir_batch_begin (void);
+void pagedir_batch_end (void);
+void pagedir_print_stats (void);
 
 #endif /* userprog/pagedir.h */
@@ -15,15 +15,21 @@
 #include "threads/init.h"
 #include "threads/interrupt.h"
 #include "vm/page.h"
+#include "vm/vma.h"
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+#include "filesys/inode.h"
 #include "threads/flags.h"
 
 const int WORD_SIZE = 4; /* Number of bytes per word */
 
+/* Stack pages mapped by exec before the program runs. */
+size_t stack_exec_pages = 1;
+
 //Function declarations
 static thread_func start_process NO_RETURN;
+static thread_func fork_process NO_RETURN;
 static bool load (const char *cmdline, void (**eip) (void), void **esp);
 void test_stack (int *t);
 
@@ -50,6 +56,11 @@ static void start_process (void *file_name_)
   struct intr_frame if_;
   bool success;
   char *file_name = file_name_;
+  struct thread *t = thread_current ();
+
+  /* The parent waits in exec() until we are loaded. */
+  if (t->parent != NULL)
+    t->rss_limit = t->parent->exec_rss_limit;
   memset (&if_, 0, sizeof if_);
   if_.gs = if_.fs = if_.es = if_.ds = if_.ss = SEL_UDSEG;
   if_.cs = SEL_UCSEG;
@@ -81,6 +92,100 @@ static void start_process (void *file_name_)
   NOT_REACHED ();
 }
 
+/* Creates a child process that is a copy of the current one, as
+   it is inside the system call that asked for it.  The child
+   shares the parent's pages copy-on-write, its open files and its
+   file mappings.  Returns the child's thread id, or TID_ERROR if
+   it cannot be created.  In the child, the system call returns
+   0. */
+tid_t process_fork (void)
+{
+  struct thread *cur = thread_current ();
+
+  /* The user context saved on entry to the kernel sits at the top
+     of the kernel stack. */
+  struct intr_frame *parent_if =
+    (struct intr_frame *) ((uint8_t *) cur + PGSIZE) - 1;
+
+  write_back_mmaps ();
+  tid_t tid = thread_create (cur->name, PRI_DEFAULT, fork_process,
+                             parent_if);
+  if (tid == TID_ERROR)
+    return TID_ERROR;
+
+  struct thread *child = get_child_thread_from_id (tid);
+  if (child == NULL)
+    return TID_ERROR;
+
+  /* Wait until the child has copied what it needs from us. */
+  sema_down (&child->sema_ready);
+  if (!child->load_complete)
+    tid = TID_ERROR;
+  sema_up (&child->sema_ack);
+  return tid;
+}
+
+static void fork_process (void *parent_if_)
+{
+  struct intr_frame if_;
+  struct thread *cur = thread_current ();
+  struct thread *parent = cur->parent;
+  bool success = false, forked;
+  int i;
+
+  memcpy (&if_, parent_if_, sizeof if_);
+  if_.eax = 0;
+  cur->rss_limit = parent->rss_limit;
+  cur->exec_rss_limit = parent->exec_rss_limit;
+
+  cur->pagedir = pagedir_create ();
+  if (cur->pagedir == NULL)
+    goto done;
+  process_activate ();
+
+  lock_acquire (&file_lock);
+  if (parent->executable_file != NULL)
+    cur->executable_file = file_dup (parent->executable_file);
+  for (i = 0; i < MAX_FILES; i++)
+    if (parent->files[i] != NULL)
+      cur->files[i] = file_dup (parent->files[i]);
+  forked = vma_fork (parent->vma_root, &cur->vma_root);
+  lock_release (&file_lock);
+
+  if (!forked || !fork_spt (parent))
+    goto done;
+
+  for (i = 0; i < MAX_FILES; i++)
+    if (parent->mmap_files[i] != NULL)
+      cur->mmap_files[i] = vma_find (cur->vma_root,
+                                     parent->mmap_files[i]->start);
+  success = true;
+
+ done:
+  if (!success){
+    lock_acquire (&file_lock);
+    for (i = 0; i < MAX_FILES; i++)
+      if (cur->files[i] != NULL)
+      {
+        file_close (cur->files[i]);
+        cur->files[i] = NULL;
+      }
+    lock_release (&file_lock);
+    sema_up (&cur->sema_ready);
+    enum intr_level old_level = intr_disable ();
+    cur->no_yield = true;
+    sema_up (&cur->sema_terminated);
+    thread_block ();
+    intr_set_level (old_level);
+    thread_exit ();
+  }
+  cur->load_complete = true;
+  sema_up (&cur->sema_ready);
+
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+  NOT_REACHED ();
+}
+
 /* Waits for thread TID to die and returns its exit status.  If
    it was terminated by the kernel (i.e. killed due to an
    exception), returns -1.  If TID is invalid or if it was not a
@@ -101,33 +206,130 @@ int process_wait (tid_t child_tid UNUSED)
   return status;
 }
 
-/* Free the current process's resources. */
+/* Reaper: processes that have exited, whose address spaces are
+   still to be freed.  Tearing down a large address space takes a
+   while, and a parent waiting for the process need not wait for
+   it. */
+static struct list reap_list;
+static struct lock reap_lock;
+static struct semaphore reap_wakeup;
+static long long reap_cnt;
+
+static void reaper (void *);
+
+/* Starts the reaper thread. */
+void process_reaper_start (void)
+{
+  list_init (&reap_list);
+  lock_init (&reap_lock);
+  sema_init (&reap_wakeup, 0);
+  thread_create ("reaper", PRI_DEFAULT, reaper, NULL);
+}
+
+/* Starts freeing the current process's resources, and returns
+   before they are all free.  Only the dirty pages of its file
+   mappings are written back here, so that once the exit status is
+   seen the files hold what the process wrote, and its executable
+   can be written again.  The frames, swap, page tables and
+   supplementary page table are left to the reaper. */
+void process_release (void)
+{
+  struct thread *cur = thread_current ();
+
+  if (cur->pagedir == NULL || cur->reap_queued)
+    return;
+  sync_mmaps ();
+
+  /* The text page cache is keyed by the executable's inode, which
+     must stay open while our frames are in the cache: the reaper
+     closes it. */
+  if (cur->executable_file)
+  {
+    /* May be shared with a forked process. */
+    lock_acquire (&file_lock);
+    cur->reap_inode = inode_reopen (file_get_inode (cur->executable_file));
+    file_close (cur->executable_file);
+    cur->executable_file = NULL;
+    lock_release (&file_lock);
+  }
+
+  cur->reap_queued = true;
+  lock_acquire (&reap_lock);
+  list_push_back (&reap_list, &cur->reap_elem);
+  lock_release (&reap_lock);
+  sema_up (&reap_wakeup);
+}
+
+/* Free the current process's resources.  The thread itself is
+   freed when this returns, so it waits for the reaper: the pages
+   the reaper frees refer to the thread as their owner. */
 void process_exit (void)
 {
   struct thread *cur = thread_current ();
-  uint32_t *pd;
-  struct hash *supp_page_table;
+
+  process_release ();
+  if (cur->reap_queued)
+    sema_down (&cur->sema_reaped);
+
   if (cur->executable_file)
   {
+    lock_acquire (&file_lock);
     file_close (cur->executable_file);
     cur->executable_file = NULL;
+    lock_release (&file_lock);
+  }
+}
+
+/* Frees the address space of T, an exited process. */
+static void reap (struct thread *t)
+{
+  uint32_t *pd = t->pagedir;
+
+  /* Free the frames first; this also unmaps the shared zero page,
+     which pagedir_destroy() must not free.  T's thread may be
+     running again, waiting for us in process_exit(): it must not
+     activate PD once it is being destroyed.  pagedir_destroy()
+     takes care of a kernel thread, us included, still running on
+     PD. */
+  reap_spt (t);
+  lock_acquire (&file_lock);
+  vma_destroy (&t->vma_root);
+  lock_release (&file_lock);
+  t->pagedir = NULL;
+  pagedir_destroy (pd);
+
+  if (t->reap_inode != NULL)
+  {
+    lock_acquire (&file_lock);
+    inode_close (t->reap_inode);
+    t->reap_inode = NULL;
+    lock_release (&file_lock);
+  }
+}
+
+/* Reaper thread.  Frees the address spaces of exited processes,
+   in the order they exited. */
+static void reaper (void *aux UNUSED)
+{
+  for (;;)
+  {
+    struct thread *t;
+
+    sema_down (&reap_wakeup);
+    lock_acquire (&reap_lock);
+    t = list_entry (list_pop_front (&reap_list), struct thread, reap_elem);
+    lock_release (&reap_lock);
+
+    reap (t);
+    reap_cnt++;
+    sema_up (&t->sema_reaped);
   }
-   /* Destroy the current process's page directory and switch back
-     to the kernel-only page directory. */
-  pd = cur->pagedir;
-  if (pd != NULL) 
-    {
-      /* Correct ordering here is crucial.  We must set
-         cur->pagedir to NULL before switching page directories,
-         so that a timer interrupt can't switch back to the
-         process page directory.  We must activate the base page
-         directory before destroying the process's page
-         directory, or our active page directory will be one
-         that's been freed (and cleared). */
-      cur->pagedir = NULL;
-      pagedir_activate (NULL);
-      pagedir_destroy (pd);
-    }
+}
+
+/* Prints reaper statistics. */
+void process_print_stats (void)
+{
+  printf ("Reaper: %lld address spaces freed\n", reap_cnt);
 }
 
 /* Sets up the CPU for running user code in the current
@@ -137,8 +339,12 @@ void process_activate (void)
 {
   struct thread *t = thread_current ();
 
-  /* Activate thread's page tables. */
-  pagedir_activate (t->pagedir);
+  /* Activate thread's page tables.  A kernel thread has none and
+     never touches user memory, so it keeps the page directory that
+     is active, whose kernel half is the same as everyone's; the
+     process that ran before it then comes back to a warm TLB. */
+  if (t->pagedir != NULL)
+    pagedir_activate (t->pagedir);
 
   /* Set thread's kernel stack for use in processing
      interrupts. */
@@ -447,7 +653,13 @@ static bool setup_stack (void **esp, char *file_name, char *args)
 {
   uint8_t *kpage;
   bool success = false;
-  success = stack_increase (((uint8_t *) PHYS_BASE) - PGSIZE,false,NULL);
+  /* Reserve the address space the stack may grow into, so that no
+     file is mapped there. */
+  if (vma_create (&thread_current ()->vma_root,
+                  (uint8_t *) PHYS_BASE - MAX_STACK_SIZE, PHYS_BASE, CODE,
+                  NULL, 0, 0, true) == NULL)
+    return false;
+  success = stack_populate (stack_exec_pages);
   if (success){
     *esp = PHYS_BASE;
     char *token, *save_ptr;
@@ -10,9 +10,16 @@
 /* Lock for file system calls. */
 struct lock file_lock;
 
+/* -stk: stack pages mapped by exec. */
+extern size_t stack_exec_pages;
+
 tid_t process_execute (const char *file_name);
+tid_t process_fork (void);
 int process_wait (tid_t);
+void process_release (void);
 void process_exit (void);
+void process_reaper_start (void);
+void process_print_stats (void);
 void process_activate (void);
 bool install_page (void *, void *, bool);
 
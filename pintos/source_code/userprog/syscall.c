@@ -4,12 +4,18 @@
 #include <string.h>
 #include "threads/synch.h"
 #include "threads/interrupt.h"
+#include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "userprog/pagedir.h"
 #include "userprog/process.h"
+#include "userprog/exception.h"
 #include "vm/page.h"
+#include "vm/frame.h"
+#include "vm/swap.h"
+#include "vm/vma.h"
 #include "filesys/filesys.h"
+#include <mman.h>
 
 //Function declarations
 static void close_file (int);
@@ -24,14 +30,10 @@ static void valid_up (const void*, const void *);
 static void
 unpin_buffer (void *buffer, unsigned size)
 {
-  struct spt_entry *spte = uvaddr_to_spt_entry (buffer);
+  uint32_t *pd = thread_current ()->pagedir;
   int i;
   for (i = 0; i < size; i += PGSIZE)
-  {
-    spte = uvaddr_to_spt_entry (buffer + i);
-    if (spte != NULL)
-      spte->pinned = false;
-  }
+    frame_unpin_upage (pd, buffer + i);
 }
 
 static void
@@ -69,7 +71,6 @@ int exit (void *esp)
     }
   }
 
-  destroy_spt (&t->supp_page_table);
   char *name = t->name, *save;
   name = strtok_r (name, " ", &save);
 
@@ -78,7 +79,7 @@ int exit (void *esp)
   lock_release (&file_lock);
 
   t->return_status = status;
-  process_exit ();
+  process_release ();
 
   enum intr_level old_level = intr_disable ();
   t->no_yield = true;
@@ -358,18 +359,28 @@ static int mmap (void *esp)
   lock_acquire (&file_lock);
   int size = file_length (f);
   lock_release (&file_lock);
-  struct spt_entry *spte = create_spte_mmap (f, size, address);
-  if (spte == NULL) return -1;
+  struct vma *vma = create_vma_mmap (f, size, address);
+  if (vma == NULL)
+  {
+    lock_acquire (&file_lock);
+    file_close (f);
+    lock_release (&file_lock);
+    return -1;
+  }
   int i;
   for (i = 0; i<MAX_FILES; i++)
   {
     if (t->mmap_files[i] == NULL){
-      t->mmap_files[i] = spte;
+      t->mmap_files[i] = vma;
       break;
     }
   }
 
-  if (i == MAX_FILES) return -1;
+  if (i == MAX_FILES)
+  {
+    free_vma_mmap (vma);
+    return -1;
+  }
   else return i;
 }
 
@@ -383,9 +394,12 @@ static int munmap (void *esp)
   if (FDcheck (map_id))
   {    
     struct thread *t = thread_current();
-    struct spt_entry *spte = t->mmap_files[map_id];
-    if (spte != NULL)
-      free_spte_mmap (spte);
+    struct vma *vma = t->mmap_files[map_id];
+    if (vma != NULL)
+    {
+      free_vma_mmap (vma);
+      t->mmap_files[map_id] = NULL;
+    }
   }
 }
 
@@ -410,8 +424,143 @@ static int mkdir (void *esp)
   exit (NULL);
 }
 
+// Duplicates the current process; returns the child's pid, or 0 in the child
+static int sys_fork (void *esp UNUSED)
+{
+  return process_fork ();
+}
+
+// Copies SIZE bytes from SRC to the user buffer DST, if it is not null
+static void copy_out (const void *esp, void *dst, const void *src, size_t size)
+{
+  if (dst == NULL)
+    return;
+  validate (esp, dst, size);
+  is_writable (dst);
+  memcpy (dst, src, size);
+  unpin_buffer (dst, size);
+  unpin_buffer (dst + size - 1, 1);
+}
+
+// Reports page fault statistics of this process and of the whole system
+static int faultstat (void *esp)
+{
+  validate (esp, esp, 3 * sizeof (void *));
+  struct fault_stats *process = *((struct fault_stats **) esp);
+  struct fault_stats *all = *((struct fault_stats **) (esp + sizeof (void *)));
+  struct fault_hist *hist = *((struct fault_hist **) (esp + 2 * sizeof (void *)));
+  struct fault_stats st;
+
+  st = thread_current ()->fault_stats;
+  st.rss = thread_current ()->rss;
+  copy_out (esp, process, &st, sizeof st);
+  st = *exception_fault_stats ();
+  st.rss = palloc_user_page_cnt () - palloc_user_free_cnt ();
+  copy_out (esp, all, &st, sizeof st);
+  copy_out (esp, hist, exception_fault_hist (), sizeof *hist);
+  return 0;
+}
+
+// Writes back the dirty pages of file mappings in the given range
+static int msync (void *esp)
+{
+  validate (esp, esp, 3 * sizeof (int));
+  uint8_t *addr = *((uint8_t **) esp);
+  unsigned length = *((unsigned *) (esp + sizeof (void *)));
+  int flags = *((int *) (esp + sizeof (void *) + sizeof (unsigned)));
+  struct thread *t = thread_current ();
+  bool sync = (flags & MS_SYNC) != 0;
+  uint8_t *end = addr + length;
+  uint8_t *upage;
+  bool queued = false;
+
+  if (!is_valid_page (addr) || end < addr || !is_user_vaddr (end - 1)
+      || (flags & ~(MS_ASYNC | MS_SYNC)) != 0
+      || (flags & (MS_ASYNC | MS_SYNC)) == (MS_ASYNC | MS_SYNC))
+    return -1;
+  for (upage = addr; upage < end; upage += PGSIZE)
+    if (vma_find (t->vma_root, upage) == NULL)
+      return -1;
+
+  for (upage = addr; upage < end; upage += PGSIZE)
+    frame_msync_page (t->pagedir, upage, sync);
+  frame_msync_finish (sync);
+
+  /* Another thread may have taken some of the pages off the queue
+     and be writing them still: wait for it, and write again the
+     pages dirtied meanwhile. */
+  if (sync)
+  {
+    for (upage = addr; upage < end; upage += PGSIZE)
+      queued |= frame_msync_page (t->pagedir, upage, true);
+    if (queued)
+      frame_msync_finish (true);
+  }
+  return 0;
+}
+
+// Tells the pager how the given range of memory is going to be used
+static int madvise (void *esp)
+{
+  validate (esp, esp, 3 * sizeof (int));
+  uint8_t *addr = *((uint8_t **) esp);
+  unsigned length = *((unsigned *) (esp + sizeof (void *)));
+  int advice = *((int *) (esp + sizeof (void *) + sizeof (unsigned)));
+  struct thread *t = thread_current ();
+  uint8_t *end = addr + length;
+  uint8_t *upage;
+
+  if (!is_valid_page (addr) || end < addr || !is_user_vaddr (end - 1)
+      || advice < MADV_NORMAL || advice > MADV_NOHUGEPAGE)
+    return -1;
+  for (upage = addr; upage < end; upage += PGSIZE)
+    if (vma_find (t->vma_root, upage) == NULL)
+      return -1;
+
+  return page_madvise (addr, end, advice) ? 0 : -1;
+}
+
+// Limits the resident set, in pages, of processes exec'd from now on; 0 for no limit
+static int rsslimit (void *esp)
+{
+  validate (esp, esp, sizeof (unsigned));
+  unsigned pages = *((unsigned *) esp);
+  frame_set_rss_limit (pages);
+  return 0;
+}
+
+// Reports page merging statistics, after a full scan of memory if asked to wait for one
+static int mergestat (void *esp)
+{
+  validate (esp, esp, 2 * sizeof (void *));
+  struct merge_stats *stats = *((struct merge_stats **) esp);
+  bool wait = *((int *) (esp + sizeof (void *))) != 0;
+  struct merge_stats st;
+
+  if (wait)
+    frame_merge_wait ();
+  frame_merge_stats (&st);
+  copy_out (esp, stats, &st, sizeof st);
+  return 0;
+}
+
+// Reports the swap use of this process and of the whole system
+static int swapstat (void *esp)
+{
+  validate (esp, esp, 2 * sizeof (void *));
+  struct swap_stats *process = *((struct swap_stats **) esp);
+  struct swap_stats *all = *((struct swap_stats **) (esp + sizeof (void *)));
+  struct swap_stats st;
+
+  page_swap_stats (&st);
+  copy_out (esp, process, &st, sizeof st);
+  swap_get_stats (&st);
+  copy_out (esp, all, &st, sizeof st);
+  return 0;
+}
+
 // List of system calls
-static int (*syscalls []) (void *) ={halt,exit,exec,wait,create,remove,open,filesize,read,write,seek,tell,close,mmap,munmap,chdir,mkdir,readdir,isdir,inumber};
+static int (*syscalls []) (void *) ={halt,exit,exec,wait,create,remove,open,filesize,read,write,seek,tell,close,mmap,munmap,chdir,mkdir,readdir,isdir,inumber,sys_fork,faultstat,msync,madvise,rsslimit,mergestat,swapstat};
 
 const int num_calls = sizeof (syscalls) / sizeof (syscalls[0]);
 void syscall_init (void) 
@@ -424,6 +573,10 @@ static void syscall_handler (struct intr_frame *f UNUSED)
 {
   void *esp = f->esp;
 
+  /* Killed for lack of memory. */
+  if (thread_current ()->oom_killed)
+    exit (NULL);
+
   validate (esp, esp, sizeof(int));
   int syscall_num = *((int *) esp);
   esp += sizeof(int);
@@ -489,18 +642,18 @@ valid_up (const void *esp, const void *ptr)
     exit (NULL);
   }
   
-  struct spt_entry *spte = uvaddr_to_spt_entry (ptr);
-  if (spte != NULL)
+  /* Load the page if needed and pin its frame; retry if it was
+     evicted again before the pin took hold. */
+  while (!frame_pin_upage (pd, ptr))
   {
-    spte->pinned = true;
-    if (pagedir_get_page (pd, ptr) == NULL)
+    struct spt_entry *spte = uvaddr_to_spt_entry (ptr);
+    if (spte != NULL)
+    {
       if(!install_load_page (spte))
         exit (NULL);
-  }
-  else if (pagedir_get_page (pd, ptr) == NULL)
-  {
-    if(!(ptr >= esp - STACK_HEURISTIC &&
-         stack_increase(ptr, true,NULL)))
+    }
+    else if(!(ptr >= esp - STACK_HEURISTIC &&
+              stack_increase(ptr, true)))
       exit (NULL);
   }
 }
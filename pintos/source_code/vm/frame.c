@@ -2,139 +2,687 @@
 #include "threads/palloc.h"
 #include "vm/frame.h"
 #include "vm/page.h"
-#include <malloc.h>
+#include "threads/malloc.h"
+#include "threads/vaddr.h"
 #include <list.h>
 #include "userprog/pagedir.h"
 #include <bitmap.h>
 #include "vm/swap.h"
+#include "vm/oom.h"
+#include "userprog/process.h"
+#include "userprog/exception.h"
+#include "filesys/file.h"
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/pte.h"
+#include "vm/vma.h"
+#include <mman.h>
+#include <stdio.h>
+#include <string.h>
 
-//Declaration of locks and lists to be used
-static struct list frame_table;
+/* Frame table: one entry per user pool frame, indexed by the
+   frame's position in the pool.  An entry with a null FRAME is
+   not in use by any user page. */
+static struct frame_table_entry *frame_table;
+static size_t frame_table_size;
 static struct lock frame_table_lock;
 
+/* Clock hand: index of the next frame the replacement sweep
+   looks at.  It keeps its position between evictions. */
+static size_t clock_hand;
+
+/* Frames waiting to be written outside frame_table_lock: dirty
+   MMAP frames found by the sweep, to be written back to their
+   files, and evicted pages on their way to swap.  CLEANING_CNT
+   counts the frames queued or being written. */
+static struct list dirty_queue;
+static struct condition cleaning_done;
+static size_t cleaning_cnt;
+
+/* Free frame watermarks.  When fewer than PAGES_LOW user frames
+   are free the pageout daemon is woken, and it reclaims frames
+   until PAGES_HIGH are free.  A faulting thread reclaims a frame
+   itself only when PAGES_MIN or fewer are free. */
+static size_t pages_min, pages_low, pages_high;
+static struct semaphore pageout_wakeup;
+static bool pageout_kicked;
+
+/* The pageout daemon evicts up to PAGEOUT_BATCH frames before
+   writing them out, and with more than one swap device it wakes
+   a cleaner thread for each further device, so that the writes
+   the batch needs go to the disks it is striped over at the same
+   time. */
+#define PAGEOUT_BATCH 16
+static struct semaphore cleaner_wakeup;
+static int cleaner_cnt;
+
+/* Writeback thread: every WRITEBACK_INTERVAL ticks it writes back
+   dirty MMAP frames that have stayed dirty for WRITEBACK_AGE
+   ticks, at most WRITEBACK_BATCH of them at a time, so that
+   munmap() and exit() find little left to write and a crash loses
+   at most a few seconds of changes. */
+#define WRITEBACK_INTERVAL (TIMER_FREQ)
+#define WRITEBACK_AGE (3 * TIMER_FREQ)
+#define WRITEBACK_BATCH 32
+static long long writeback_cnt;
+static long long msync_cnt;
+
+/* Page replacement policy. */
+enum frame_policy frame_policy = POLICY_CLOCK;
+
+/* 2Q replacement.  A page enters memory cold.  Cold frames form
+   the A1in queue: the clock hand evicts them in its own, FIFO,
+   order whether they were accessed or not, as long as there are
+   at least COLD_TARGET of them, so a scan passes through them
+   without disturbing anything else.  An evicted cold page is
+   remembered in the GHOST table, the A1out queue; if it faults in
+   again before its entry is overwritten, it has been reused and
+   comes in hot.  Hot frames form the Am queue, managed by second
+   chance, and are evicted only when the cold queue is short.
+
+   GHOST is direct mapped by a hash of the page's identity, and
+   holds only the hash, so an entry is replaced by any later page
+   hashing to the same slot. */
+static unsigned *ghost;
+static size_t ghost_size;
+static size_t hot_cnt;
+static size_t cold_target;
+static long long ghost_hit_cnt;
+static long long cold_evict_cnt;
+static long long hot_evict_cnt;
+
+/* Frames evicted by processes over their resident set limit from
+   their own pages, and frames kept on the first clock pass because
+   their process was within its working set. */
+static long long local_reclaim_cnt;
+static long long ws_protect_cnt;
+
+/* Frames reclaimed by faulting threads and by the daemon. */
+static long long direct_reclaim_cnt;
+static long long background_reclaim_cnt;
+
+/* Pages whose frames frame_release_spt() releases under one
+   acquisition of frame_table_lock. */
+#define RELEASE_BATCH 64
+
+/* Frames shared by fork(), and private copies made on a write. */
+static long long fork_share_cnt;
+static long long cow_copy_cnt;
+
+/* Text page cache: frames holding read-only executable pages,
+   keyed by the inode and offset they were read from, so that every
+   process running the same program maps the same frame.  Protected
+   by frame_table_lock. */
+static struct hash text_cache;
+static long long text_cache_hit_cnt;
+static long long text_cache_drop_cnt;
+
+/* Same-page merging.  With -merge on the kernel command line, a
+   scanner thread at the lowest priority hashes the contents of
+   anonymous frames, MERGE_BATCH of them every MERGE_INTERVAL
+   ticks, and merges frames holding the same contents into one.
+   The merged frame is shared read-only, like a page after fork(),
+   and a write to it makes a private copy in frame_cow_break().
+   MERGE_TABLE holds the frames hashed during the current pass of
+   the scanner over the frame table, keyed by MERGE_SUM, and is
+   emptied at the end of each pass.  Protected by
+   frame_table_lock. */
+#define MERGE_INTERVAL (TIMER_FREQ / 10)
+#define MERGE_BATCH 64
+bool frame_merge;
+static struct hash merge_table;
+static size_t merge_hand;
+static long long merge_pass;
+static struct condition merge_pass_done;
+static long long merge_cnt;
+static long long merge_scan_cnt;
+static long long merge_cycles;
+
 //Function declarations
 static void clear_frame_entry (struct frame_table_entry *);
+static void release_page_locked (struct spt_entry *);
+static void pageout_daemon (void *);
+static void pageout_kick (void);
+static void cleaner_thread (void *);
+static void writeback_daemon (void *);
+static size_t writeback_sweep (void);
+static void sharer_add (struct frame_table_entry *, struct spt_entry *);
+static void sharer_remove (struct frame_table_entry *, struct spt_entry *);
+static void spte_set_cold (struct spt_entry *);
+static void working_set_sample (void);
+static void frame_trim_local (struct thread *);
+static bool twoq_evictable (struct frame_table_entry *, bool);
+static unsigned ghost_key (struct spt_entry *);
+static bool ghost_test (struct spt_entry *);
+static struct frame_table_entry *clock_sweep (void);
+static bool frame_swap_full (struct frame_table_entry *);
+static bool frame_queue_dirty (struct frame_table_entry *);
+static void frame_queue_clean (struct frame_table_entry *);
 static void *frame_alloc (enum palloc_flags, void* AUX);
+static bool write_frame_back (struct frame_table_entry *);
+static void clean_dirty_frames (void);
+static hash_hash_func text_cache_hash;
+static hash_less_func text_cache_less;
+static void merge_daemon (void *);
+static void merge_scan_frame (void);
+static bool merge_frames (struct frame_table_entry *,
+                          struct frame_table_entry *);
+static hash_hash_func merge_hash;
+static hash_less_func merge_less;
 bool evict_frame (struct frame_table_entry *);
 
-//Initialising frame table lock and list
+//Initialising frame table lock and array
 void frame_table_init (void)
 {
-  list_init (&frame_table);
+  size_t i;
+
+  frame_table_size = palloc_user_page_cnt ();
+  frame_table = malloc (frame_table_size * sizeof *frame_table);
+  if (frame_table == NULL && frame_table_size > 0)
+    PANIC ("Not able to allocate frame table");
+  for (i = 0; i < frame_table_size; i++)
+  {
+    frame_table[i].frame = NULL;
+    list_init (&frame_table[i].sharers);
+    frame_table[i].share_cnt = 0;
+    frame_table[i].cached = false;
+    frame_table[i].referenced = false;
+    frame_table[i].hot = false;
+    frame_table[i].pinned = false;
+    frame_table[i].cleaning = false;
+    frame_table[i].swap_slot = BITMAP_ERROR;
+    frame_table[i].merged = false;
+  }
+  list_init (&dirty_queue);
+  hash_init (&text_cache, text_cache_hash, text_cache_less, NULL);
+  hash_init (&merge_table, merge_hash, merge_less, NULL);
   lock_init (&frame_table_lock);
+  cond_init (&cleaning_done);
+  cond_init (&merge_pass_done);
+  clock_hand = 0;
+  merge_hand = 0;
+
+  if (frame_policy == POLICY_2Q)
+  {
+    ghost_size = frame_table_size / 2 + 1;
+    ghost = calloc (ghost_size, sizeof *ghost);
+    if (ghost == NULL)
+      PANIC ("Not able to allocate 2Q history");
+    cold_target = frame_table_size / 4 + 1;
+  }
+
+  pages_min = frame_table_size / 64 + 1;
+  pages_low = 2 * pages_min;
+  pages_high = 3 * pages_min;
+  sema_init (&pageout_wakeup, 0);
+  pageout_kicked = false;
+  sema_init (&cleaner_wakeup, 0);
+  cleaner_cnt = 0;
+}
+
+/* Starts the pageout daemon, its cleaner threads and the
+   writeback thread, and the page merging scanner if asked for.
+   Called once swap is available. */
+void
+pageout_start (void)
+{
+  thread_create ("pageout", PRI_DEFAULT, pageout_daemon, NULL);
+  for (cleaner_cnt = 0; cleaner_cnt < swap_device_count () - 1;
+       cleaner_cnt++)
+    thread_create ("cleaner", PRI_DEFAULT, cleaner_thread, NULL);
+  thread_create ("writeback", PRI_DEFAULT, writeback_daemon, NULL);
+  if (frame_merge)
+    thread_create ("merge", PRI_MIN, merge_daemon, NULL);
 }
 
-/* Unoptimized enhanced second-chance page replacement. 
-   Called with frame_table_lock in aquired state. */
+/* Prints frame reclaim statistics. */
+void
+frame_print_stats (void)
+{
+  printf ("Frames: %zu user frames, %zu free, watermarks %zu/%zu/%zu\n",
+          frame_table_size, palloc_user_free_cnt (),
+          pages_min, pages_low, pages_high);
+  printf ("Frames: %lld direct reclaims, %lld background reclaims\n",
+          direct_reclaim_cnt, background_reclaim_cnt);
+  printf ("Frames: %lld shared by fork, %lld copied on write\n",
+          fork_share_cnt, cow_copy_cnt);
+  printf ("Frames: %zu text pages cached, %lld cache hits, %lld dropped\n",
+          hash_size (&text_cache), text_cache_hit_cnt, text_cache_drop_cnt);
+  printf ("Frames: %lld mapped pages written back in the background, "
+          "%lld by msync\n", writeback_cnt, msync_cnt);
+  if (frame_policy == POLICY_2Q)
+    printf ("Frames: 2Q, %zu hot, %lld history hits, %lld cold and "
+            "%lld hot evictions\n", hot_cnt, ghost_hit_cnt, cold_evict_cnt,
+            hot_evict_cnt);
+  printf ("Frames: %lld evicted by processes over their RSS limit, "
+          "%lld kept for working sets\n", local_reclaim_cnt, ws_protect_cnt);
+  if (frame_merge)
+    printf ("Frames: %lld pages merged, %lld frames scanned in %lld "
+            "cycles\n", merge_cnt, merge_scan_cnt, merge_cycles);
+}
+
+/* Returns true if enough frames are free that loading pages no one
+   has asked for yet, as readahead does, will not cause eviction. */
+bool
+frame_plenty (void)
+{
+  return palloc_user_free_cnt () >= pages_low;
+}
+
+/* Returns the frame table entry for user pool page KPAGE. */
 static struct frame_table_entry *
-get_victim_frame ()
+frame_entry (void *kpage)
+{
+  size_t idx = palloc_user_page_idx (kpage);
+  ASSERT (idx < frame_table_size);
+  return &frame_table[idx];
+}
+
+/* Returns the frame table entry of the frame mapped at user page
+   UPAGE in page directory PD, or NULL if UPAGE is not resident in
+   a frame of its own. */
+static struct frame_table_entry *
+upage_entry (uint32_t *pd, const void *upage)
+{
+  void *kpage = pagedir_get_page (pd, pg_round_down (upage));
+  return kpage != NULL && !is_zero_page (kpage) ? frame_entry (kpage) : NULL;
+}
+
+/* Reverse map: returns the frame table entry, giving the
+   spt_entry's, and through them the owner threads, and the pin
+   state of user pool page KPAGE. */
+struct frame_table_entry *
+frame_lookup (void *kpage)
+{
+  return frame_entry (pg_round_down (kpage));
+}
+
+/* Returns the spt_entry of the page in FTE.  If the frame is
+   shared after fork(), this is the first of the sharers; they all
+   hold the same page. */
+static struct spt_entry *
+frame_spte (struct frame_table_entry *fte)
+{
+  return list_entry (list_front (&fte->sharers), struct spt_entry,
+                     frame_elem);
+}
+
+/* Returns true if any process sharing FTE accessed its page since
+   the last check, and clears the accessed bits. */
+static bool
+frame_accessed (struct frame_table_entry *fte)
 {
-  ASSERT (lock_held_by_current_thread (&frame_table_lock));
   struct list_elem *e;
-  //Use dirty and access bits to replace frames for eviction
-  for (e = list_begin (&frame_table);
-       e != list_end (&frame_table);
+  bool accessed = false;
+
+  for (e = list_begin (&fte->sharers); e != list_end (&fte->sharers);
        e = list_next (e))
   {
-    struct frame_table_entry *fte =
-      list_entry (e, struct frame_table_entry, elem);
-    bool is_dirty = pagedir_is_dirty (fte->t->pagedir,
-                                      fte->spte->upage);
-    bool is_accessed = pagedir_is_accessed (fte->t->pagedir,
-                                            fte->spte->upage);
-
-    if (!fte->spte->pinned)
+    struct spt_entry *spte = list_entry (e, struct spt_entry, frame_elem);
+    uint32_t *pd = spte->owner->pagedir;
+    if (pagedir_is_accessed (pd, spte->upage))
     {
-      if (fte->spte->type != CODE)
-      {
-        if (is_dirty)
-        {
-          if (write_to_disk (fte->spte))
-            pagedir_set_dirty (fte->t->pagedir, fte->spte->upage, false);
-        }
-        else if (!is_accessed)
-          return fte;
-      }
-      else
-      {
-        if (!is_dirty && !is_accessed)
-          return fte;
-      }
+      /* A large page has one accessed bit for all its pages, and
+         they are looked at in order: clear it at the last one, so
+         that the others see it too. */
+      if (!pagedir_is_large (pd, spte->upage)
+          || pg_no (spte->upage) % LARGE_PAGE_CNT == LARGE_PAGE_CNT - 1)
+        pagedir_set_accessed (pd, spte->upage, false);
+      accessed = true;
     }
   }
-  for (e = list_begin (&frame_table);
-       e != list_end (&frame_table);
-       e = list_next (e))
+  return accessed;
+}
+
+/* Returns true if the page in FTE belongs to a region advised
+   MADV_SEQUENTIAL, so that it can be dropped once read. */
+static bool
+frame_use_once (struct frame_table_entry *fte)
+{
+  struct vma *vma = frame_spte (fte)->vma;
+  return vma != NULL && vma->advice == MADV_SEQUENTIAL;
+}
+
+/* Returns true if the process owning the page in FTE has more
+   frames than its working set needs. */
+static bool
+frame_over_ws (struct frame_table_entry *fte)
+{
+  struct thread *owner = frame_spte (fte)->owner;
+  return owner->rss > owner->wss;
+}
+
+/* Adds SPTE to the processes sharing FTE, whose frame is now
+   mapped at SPTE's page. */
+static void
+sharer_add (struct frame_table_entry *fte, struct spt_entry *spte)
+{
+  if (spte->cold)
   {
-    struct frame_table_entry *fte =
-      list_entry (e, struct frame_table_entry, elem);
-    bool is_dirty = pagedir_is_dirty (fte->t->pagedir,
-                                      fte->spte->upage);
-    bool is_accessed = pagedir_is_accessed (fte->t->pagedir,
-                                            fte->spte->upage);
+    list_remove (&spte->frame_elem);
+    spte->cold = false;
+  }
+  list_push_back (&fte->sharers, &spte->frame_elem);
+  fte->share_cnt++;
+  spte->owner->rss++;
+}
+
+/* Puts SPTE, whose page has just been evicted, on its owner's
+   list of entries to free, if the page table entry and the region
+   are enough to create it again: a swap entry, or a file page of a
+   region.  Only the owner may change its supplementary page table,
+   so it frees them itself, with page_free_cold(); until then the
+   entry may still be used, and is taken off the list when it gets
+   a frame again. */
+static void
+spte_set_cold (struct spt_entry *spte)
+{
+  if (spte->type != CODE && spte->vma == NULL)
+    return;
+  list_push_back (&spte->owner->cold_sptes, &spte->frame_elem);
+  spte->cold = true;
+}
+
+/* Takes an entry off the current process's list of entries of
+   evicted pages, for page_free_cold() to free.  Returns NULL if
+   the list is empty. */
+struct spt_entry *
+frame_pop_cold (void)
+{
+  struct list *cold = &thread_current ()->cold_sptes;
+  struct spt_entry *spte = NULL;
+
+  lock_acquire (&frame_table_lock);
+  if (!list_empty (cold))
+  {
+    spte = list_entry (list_pop_front (cold), struct spt_entry, frame_elem);
+    spte->cold = false;
+  }
+  lock_release (&frame_table_lock);
+  return spte;
+}
+
+/* Removes SPTE from the processes sharing FTE. */
+static void
+sharer_remove (struct frame_table_entry *fte, struct spt_entry *spte)
+{
+  list_remove (&spte->frame_elem);
+  fte->share_cnt--;
+  spte->owner->rss--;
+}
+
+/* 2Q: returns true if FTE, whose ACCESSED bit the hand has just
+   taken, is to be evicted.  Pages of sequentially read regions
+   always count as cold. */
+static bool
+twoq_evictable (struct frame_table_entry *fte, bool accessed)
+{
+  size_t used = frame_table_size - palloc_user_free_cnt ();
+  bool cold_long = used - hot_cnt >= cold_target;
+
+  if (!fte->hot || frame_use_once (fte))
+    return cold_long;
+  return !accessed && !cold_long;
+}
+
+/* Returns the identity of SPTE's page for the 2Q history: the
+   file and offset of a read-only executable page, which any
+   process may fault in again, or the process and address of any
+   other page.  Never 0, which marks an empty history slot. */
+static unsigned
+ghost_key (struct spt_entry *spte)
+{
+  uintptr_t id[2];
+
+  if (spte->type == FILE && !spte->writable)
+  {
+    id[0] = (uintptr_t) file_get_inode (spte->file);
+    id[1] = spte->ofs;
+  }
+  else
+  {
+    id[0] = (uintptr_t) spte->owner;
+    id[1] = (uintptr_t) spte->upage;
+  }
+  return hash_bytes (id, sizeof id) | 1;
+}
+
+/* Returns true, and forgets it, if SPTE's page is in the 2Q
+   history. */
+static bool
+ghost_test (struct spt_entry *spte)
+{
+  unsigned key = ghost_key (spte);
+  unsigned *slot = &ghost[key % ghost_size];
+
+  if (*slot != key)
+    return false;
+  *slot = 0;
+  return true;
+}
+
+/* Returns the frame under the clock hand and moves the hand one
+   step forward, wrapping around at the end of the frame table. */
+static struct frame_table_entry *
+clock_advance (void)
+{
+  struct frame_table_entry *fte = &frame_table[clock_hand];
+  clock_hand = (clock_hand + 1) % frame_table_size;
+  return fte;
+}
+
+/* Clock (second-chance) page replacement.  The hand resumes where
+   the previous eviction left it.  A frame that was accessed since
+   the hand last passed has its accessed bit cleared and is skipped
+   once.  On the first pass of the hand, frames of processes that
+   are within their working set are skipped too, so that a process
+   streaming through memory replaces its own pages rather than the
+   working sets of others.  Dirty MMAP frames are not written here;
+   they are queued for clean_dirty_frames() and skipped until they
+   are clean.  Returns NULL only if every frame is pinned or being
+   cleaned.  Called with frame_table_lock in aquired state. */
+static struct frame_table_entry *
+get_victim_frame (void)
+{
+  struct frame_table_entry *fte;
+
+  ASSERT (lock_held_by_current_thread (&frame_table_lock));
+
+  /* The sweep clears accessed bits by the hundred: invalidate the
+     TLB for them once at the end. */
+  pagedir_batch_begin ();
+  fte = clock_sweep ();
+  pagedir_batch_end ();
+  return fte;
+}
+
+/* The sweep of get_victim_frame(). */
+static struct frame_table_entry *
+clock_sweep (void)
+{
+  size_t i;
 
-    if (!fte->spte->pinned)
+  for (i = 0; i < 3 * frame_table_size; i++)
+  {
+    struct frame_table_entry *fte = clock_advance ();
+    bool accessed;
+
+    if (fte->frame == NULL || fte->pinned || fte->cleaning
+        || frame_swap_full (fte))
+      continue;
+    if (i < frame_table_size && !frame_over_ws (fte))
     {
-      if ((!is_dirty ) && !is_accessed)
-        return fte;
-      else //Accessed or (Dirty (FILE or MMAP)).
-        pagedir_set_accessed (fte->t->pagedir, fte->spte->upage, false);
+      ws_protect_cnt++;
+      continue;
     }
+
+    /* Pages of a region read sequentially are used once: they get
+       no second chance. */
+    accessed = frame_accessed (fte) || fte->referenced;
+    fte->referenced = false;
+    if (frame_policy == POLICY_2Q ? !twoq_evictable (fte, accessed)
+                                  : accessed && !frame_use_once (fte))
+      continue;
+    if (frame_queue_dirty (fte))
+      continue;
+    return fte;
   }
 
-  ASSERT (!list_empty (&frame_table));
-  for (e = list_begin (&frame_table);
-       e != list_end (&frame_table);
-       e = list_next (e))
+  /* Frames keep getting referenced behind the hand: take the next
+     one that can be evicted at all.  Dirty MMAP frames are still
+     left to the cleaner, so that no file is written under the
+     lock. */
+  for (i = 0; i < frame_table_size; i++)
   {
-    struct frame_table_entry *fte =
-      list_entry (e, struct frame_table_entry, elem);
-    if (!fte->spte->pinned){
+    struct frame_table_entry *fte = clock_advance ();
+    if (fte->frame != NULL && !fte->pinned && !fte->cleaning
+        && !frame_swap_full (fte) && !frame_queue_dirty (fte))
       return fte;
-    }
   }
   return NULL;
 }
 
+/* If FTE holds a dirty MMAP page, queues it for
+   clean_dirty_frames() and returns true. */
+static bool
+frame_queue_dirty (struct frame_table_entry *fte)
+{
+  struct spt_entry *spte = frame_spte (fte);
+
+  if (spte->type != MMAP
+      || !pagedir_is_dirty (spte->owner->pagedir, spte->upage))
+    return false;
+  frame_queue_clean (fte);
+  return true;
+}
+
+/* Queues FTE for clean_dirty_frames(), which writes it without
+   frame_table_lock.  It is left alone by eviction, merging and
+   write-back until then. */
+static void
+frame_queue_clean (struct frame_table_entry *fte)
+{
+  fte->cleaning = true;
+  list_push_back (&dirty_queue, &fte->clean_elem);
+  cleaning_cnt++;
+}
+
+/* Returns true if FTE's page would have to go to swap, and swap
+   is full. */
+static bool
+frame_swap_full (struct frame_table_entry *fte)
+{
+  struct spt_entry *spte = frame_spte (fte);
+
+  return (spte->type == CODE || (spte->type == FILE && spte->writable))
+         && swap_full ();
+}
+
+/* Evicts FTE.  Returns false, leaving it as it is, if its page
+   would have to go to swap and swap is full.  A page that goes to
+   swap is only queued for clean_dirty_frames() to write, and the
+   frame is freed once it has been; the caller writes the queue
+   out after it lets go of frame_table_lock. */
 bool
 evict_frame (struct frame_table_entry *fte)
 {
   ASSERT (lock_held_by_current_thread (&frame_table_lock));
-  struct spt_entry *spte = fte->spte;
+  struct spt_entry *spte = frame_spte (fte);
+  struct list_elem *e;
   size_t idx;
+
+  if (frame_swap_full (fte))
+    return false;
+
+  /* Unmap before writing the page out, from every process sharing
+     it, so that no owner can change it behind the write.  A fault
+     on it blocks on frame_table_lock until the eviction is
+     complete. */
+  for (e = list_begin (&fte->sharers); e != list_end (&fte->sharers);
+       e = list_next (e))
+  {
+    struct spt_entry *s = list_entry (e, struct spt_entry, frame_elem);
+    pagedir_clear_page (s->owner->pagedir, s->upage);
+    s->owner->rss--;
+  }
+
+  if (frame_policy == POLICY_2Q)
+  {
+    if (fte->hot)
+      hot_evict_cnt++;
+    else
+    {
+      unsigned key = ghost_key (spte);
+      ghost[key % ghost_size] = key;
+      cold_evict_cnt++;
+    }
+  }
+
   switch (spte->type){
   case MMAP:
 
-    /* Given frame to evict of type FILE or MMAP will 
-       never be dirty. */
+    /* Given frame to evict of type FILE or MMAP will
+       never be dirty.  MMAP frames are never shared. */
 
-    if (pagedir_is_dirty (fte->t->pagedir, spte->upage))
-        if (!write_to_disk (spte))
-        {
-          PANIC ("Not able to write out");
-          return false;
-        }
+    if (!write_frame_back (fte))
+    {
+      PANIC ("Not able to write out");
+      return false;
+    }
 
+    list_pop_front (&fte->sharers);
     spte->frame = NULL;
-    
+    pagedir_set_file (spte->owner->pagedir, spte->upage);
+    spte_set_cold (spte);
+
     clear_frame_entry (fte);
     return true;
     break;
   case FILE:
-    spte->type = CODE;
+    /* A read-only page can be read from its file again; a
+       writable one goes to swap. */
+    if (!spte->writable)
+    {
+      while (!list_empty (&fte->sharers))
+      {
+        struct spt_entry *s = list_entry (list_pop_front (&fte->sharers),
+                                          struct spt_entry, frame_elem);
+        s->frame = NULL;
+        pagedir_set_file (s->owner->pagedir, s->upage);
+        spte_set_cold (s);
+      }
+      clear_frame_entry (fte);
+      text_cache_drop_cnt++;
+      return true;
+    }
+    /* Fall through. */
   case CODE:
     ASSERT (spte->frame != NULL);
-    idx = swap_out (spte);
-    if (idx == BITMAP_ERROR){
-      PANIC ("Not able to swap out");
-      return false;
-    }
+    /* There is a free slot: nobody else swaps out meanwhile. */
+    idx = swap_alloc (spte->owner);
+    ASSERT (idx != BITMAP_ERROR);
 
-    spte->idx = idx;
-    spte->is_in_swap = true;
-    spte->frame = NULL;
+    /* Every sharer refers to the one copy written out.  The slot
+       goes into each sharer's page table entry at once, while the
+       write is still to come: a fault on the page waits for it in
+       swap_in().  The page table already exists, since the page
+       was mapped. */
+    while (!list_empty (&fte->sharers))
+    {
+      struct spt_entry *s = list_entry (list_pop_front (&fte->sharers),
+                                        struct spt_entry, frame_elem);
+      if (s != spte)
+        swap_dup (idx, s->owner);
+      s->type = CODE;
+      s->frame = NULL;
+      pagedir_set_swap (s->owner->pagedir, s->upage, idx);
+      spte_set_cold (s);
+    }
+    fte->share_cnt = 0;
 
-    clear_frame_entry (fte);
+    /* The frame now belongs to no page, only to the write. */
+    fte->swap_slot = idx;
+    frame_queue_clean (fte);
     return true;
     break;
   default:
@@ -147,13 +695,26 @@ evict_frame (struct frame_table_entry *fte)
 //Helper for frame table entry filling
 void fill_table_details(struct frame_table_entry *fte, void *frame, struct spt_entry *spte)
 {
-  fte->t = thread_current ();
-  fte->spte = spte;
-  ASSERT (fte->spte->type < 3 && fte->spte->type >= 0);
+  ASSERT (spte->type < 3 && spte->type >= 0);
+  list_init (&fte->sharers);
+  fte->share_cnt = 0;
+  sharer_add (fte, spte);
   fte->frame = frame;
+  fte->dirty_since = 0;
+  fte->referenced = false;
+  fte->merged = false;
+  fte->hot = frame_policy == POLICY_2Q && ghost_test (spte);
+  if (fte->hot)
+  {
+    hot_cnt++;
+    ghost_hit_cnt++;
+  }
 }
 
-//Helper function for allocating frame in which page would be loaded
+/* Helper function for allocating frame in which page would be
+   loaded.  The frame is returned pinned, so it cannot be evicted
+   before it is filled and mapped; the caller unpins it with
+   frame_unpin(). */
 void * retrieve_frame_of_page (enum palloc_flags flags, struct spt_entry *spte)
 {
   if(spte == NULL)
@@ -166,90 +727,1029 @@ void * retrieve_frame_of_page (enum palloc_flags flags, struct spt_entry *spte)
     frame_table_add (frame, spte);
     return frame;
   }
-  else PANIC ("Not able to get frame");
+  /* Out of memory, and the current process was killed. */
+  return NULL;
 }
 
-//Add the supplementary page table entry to the frame table
-static void frame_table_add (void *frame, struct spt_entry *spte)
+/* Add the supplementary page table entry to the frame table.  The
+   frame is left pinned, for the caller to fill, map and unpin. */
+void frame_table_add (void *frame, struct spt_entry *spte)
 {
-  struct frame_table_entry *fte =(struct frame_table_entry *) malloc (sizeof (struct frame_table_entry));
-  //Acquire frame table lock and fill the details of entry 
+  struct frame_table_entry *fte = frame_entry (frame);
+  //Acquire frame table lock and fill the details of entry
   lock_acquire (&frame_table_lock);
+  ASSERT (fte->frame == NULL);
   fill_table_details(fte,frame,spte);
-  list_push_back (&frame_table, &fte->elem);
+  fte->pinned = true;
+  fte->cleaning = false;
+  fte->swap_slot = BITMAP_ERROR;
   lock_release (&frame_table_lock);
 }
 
-//For a kernel page taken from user pool, locate kernel virtual address
+/* For a kernel page taken from user pool, locate kernel virtual
+   address.  Frames are normally taken straight from the pool and
+   the pageout daemon keeps enough of them free.  Only when the
+   pool is down to PAGES_MIN does the caller evict a frame itself.
+   If nothing can be evicted either, the OOM killer picks a process
+   to free its memory.  Returns NULL only if that process is the
+   current one, which is then to exit. */
 static void *
 frame_alloc (enum palloc_flags flags,void * AUX)
 {
   if (flags & PAL_USER == 0)
     return NULL;
 
-  void *frame = palloc_get_page (flags);
-  if (frame != NULL)
-    return frame;
-  else
+  void *frame = NULL;
+  struct thread *t = thread_current ();
+
+  if (t->oom_killed)
+    return NULL;
+
+  /* A process at its resident set limit replaces its own pages. */
+  if (t->rss_limit > 0 && t->rss >= t->rss_limit)
+    frame_trim_local (t);
+
+  if (palloc_user_free_cnt () > pages_min)
+    frame = palloc_get_page (flags);
+
+  if (frame == NULL)
   {
     lock_acquire (&frame_table_lock);
-    do {
-      if (list_empty (&frame_table))
-        PANIC ("palloc_get_page returned NULL when frame table empty.");
-
+    while (frame == NULL && !t->oom_killed)
+    {
+      uint64_t start = rdtsc ();
       struct frame_table_entry *fte = get_victim_frame ();
+      bool waited = false;
 
-      /* Always get some frame to evict. */
-      ASSERT (fte != NULL);
+      if (fte != NULL)
+      {
+        /* Check not corrupt fte or spte. */
+        ASSERT (frame_spte (fte)->type < 3 && frame_spte (fte)->type >= 0 &&
+                fte->frame != NULL);
+        ASSERT (frame_spte (fte)->frame != NULL);
 
-      /* Check not corrupt fte or spte. */
-      /*printf ("\nhere::%p, %s, %p, %d, %p, %p", fte->t,
-        fte->t->name, fte->spte, fte->spte->type,
-        fte->spte->frame, fte->spte->upage);*/
-      ASSERT (fte->spte->type < 3 && fte->spte->type >= 0 &&
-              fte->frame != NULL);
-      ASSERT (fte->spte->frame != NULL);
+        if (!evict_frame (fte))
+          PANIC ("Not able to evict. ");
+        direct_reclaim_cnt++;
+      }
+      if (!list_empty (&dirty_queue))
+      {
+        /* Write out the victim, if it went to swap, and the dirty
+           frames queued, without the lock. */
+        lock_release (&frame_table_lock);
+        clean_dirty_frames ();
+        lock_acquire (&frame_table_lock);
+        waited = true;
+      }
+      else if (fte == NULL && cleaning_cnt > 0)
+      {
+        /* Other threads are writing out frames: wait for one. */
+        cond_wait (&cleaning_done, &frame_table_lock);
+        waited = true;
+      }
+      if (fte != NULL)
+        exception_record_evict (rdtsc () - start);
 
-      bool evicted = evict_frame (fte);
-      if (evicted){
-        frame = palloc_get_page (flags);
+      frame = palloc_get_page (flags);
+      if (frame == NULL && fte == NULL && !waited)
+      {
+        /* Every frame is pinned, or holds a page for which swap is
+           full.  Kill a process and give it time to exit. */
+        if (!oom_kill ())
+          PANIC ("Out of memory");
+        lock_release (&frame_table_lock);
+        timer_sleep (1);
+        lock_acquire (&frame_table_lock);
       }
-      else
-        PANIC ("Not able to evict. ");
-    } while (frame == NULL);
-      
+    }
     lock_release (&frame_table_lock);
-    return frame;
+
+    /* Write back what the sweep queued, now that the lock is free. */
+    clean_dirty_frames ();
   }
+
+  if (palloc_user_free_cnt () < pages_low)
+    pageout_kick ();
+  return frame;
 }
 
-//Deallocate the frame to free up memory
-void free_frame (void *frame)
+/* Allocates LARGE_PAGE_CNT frames for a large page of the current
+   process: contiguous and aligned to the large page size.  The
+   pages are only worth it if memory is plentiful, so no frame is
+   evicted for them: returns NULL if taking them would leave fewer
+   than PAGES_LOW frames free or put the process over its resident
+   set limit, or if no aligned block is free.  The caller adds each
+   frame to the frame table with frame_table_add(). */
+void *
+frame_alloc_large (void)
 {
-  struct frame_table_entry *fte;
-  struct list_elem *e;
-  lock_acquire (&frame_table_lock);
-  for (e = list_begin (&frame_table);
-       e != list_end (&frame_table);
-       e = list_next (e))
+  struct thread *t = thread_current ();
+
+  if (palloc_user_free_cnt () < pages_low + LARGE_PAGE_CNT
+      || (t->rss_limit > 0 && t->rss + LARGE_PAGE_CNT > t->rss_limit))
+    return NULL;
+  return palloc_get_aligned (PAL_USER, LARGE_PAGE_CNT);
+}
+
+/* Wakes the pageout daemon, unless it has already been woken. */
+static void
+pageout_kick (void)
+{
+  if (!pageout_kicked)
+  {
+    pageout_kicked = true;
+    sema_up (&pageout_wakeup);
+  }
+}
+
+/* Pageout daemon.  Sleeps until free frames drop below PAGES_LOW,
+   then evicts frames and writes back dirty ones until PAGES_HIGH
+   are free, so that faulting threads find a free frame without
+   doing the eviction and its swap write themselves.  The writes
+   are made without frame_table_lock, so faulting threads are not
+   held up by them. */
+static void
+pageout_daemon (void *aux UNUSED)
+{
+  for (;;)
   {
-    fte = list_entry (e, struct frame_table_entry, elem);
-    if (fte->frame == frame)
+    sema_down (&pageout_wakeup);
+    pageout_kicked = false;
+
+    lock_acquire (&frame_table_lock);
+    while (palloc_user_free_cnt () < pages_high)
     {
-      list_remove (&fte->elem);
-      break;
+      size_t batch = 0;
+      int i;
+
+      /* Evict a batch, whose swap slots alternate between the
+         swap devices. */
+      while (batch < PAGEOUT_BATCH
+             && palloc_user_free_cnt () + batch < pages_high)
+      {
+        struct frame_table_entry *fte = get_victim_frame ();
+        if (fte == NULL || !evict_frame (fte))
+          break;
+        background_reclaim_cnt++;
+        batch++;
+      }
+      if (batch == 0 && list_empty (&dirty_queue))
+        break;
+
+      /* Write out the victims that went to swap, and the dirty
+         frames queued, together with the cleaners.  This also lets
+         waiting faulting threads in between batches. */
+      lock_release (&frame_table_lock);
+      for (i = 0; i < cleaner_cnt; i++)
+        sema_up (&cleaner_wakeup);
+      clean_dirty_frames ();
+      lock_acquire (&frame_table_lock);
     }
+    lock_release (&frame_table_lock);
+
+    clean_dirty_frames ();
   }
-  lock_release(&frame_table_lock);
-  palloc_free_page (frame);
 }
 
+/* Cleaner thread.  Woken by the pageout daemon for each batch, it
+   writes frames from the dirty queue alongside it. */
 static void
-clear_frame_entry (struct frame_table_entry *fte)
+cleaner_thread (void *aux UNUSED)
 {
-  ASSERT (lock_held_by_current_thread (&frame_table_lock));
-  list_remove (&fte->elem);
-  pagedir_clear_page (fte->t->pagedir, fte->spte->upage);
-  palloc_free_page (fte->frame);
-  free (fte);
+  for (;;)
+  {
+    sema_down (&cleaner_wakeup);
+    clean_dirty_frames ();
+  }
+}
+
+/* Writeback thread.  Wakes up every WRITEBACK_INTERVAL ticks and
+   writes back the MMAP frames that have been dirty for too long.
+   It also samples the working sets of the processes. */
+static void
+writeback_daemon (void *aux UNUSED)
+{
+  for (;;)
+  {
+    timer_sleep (WRITEBACK_INTERVAL);
+    working_set_sample ();
+    if (writeback_sweep () > 0)
+      clean_dirty_frames ();
+  }
+}
+
+/* Folds the frames T accessed during the last interval into its
+   working set estimate, a moving average. */
+static void
+working_set_fold (struct thread *t, void *aux UNUSED)
+{
+  t->wss = (t->wss + t->ws_sample + 1) / 2;
+  t->ws_sample = 0;
+}
+
+/* Estimates the working set of each process as the number of its
+   frames accessed since the last sample.  The accessed bits are
+   cleared, so the clock learns of the access through the frame's
+   REFERENCED flag instead. */
+static void
+working_set_sample (void)
+{
+  enum intr_level old_level;
+  size_t i;
+
+  lock_acquire (&frame_table_lock);
+  pagedir_batch_begin ();
+  for (i = 0; i < frame_table_size; i++)
+  {
+    struct frame_table_entry *fte = &frame_table[i];
+    struct list_elem *e;
+
+    if (fte->frame == NULL || !frame_accessed (fte))
+      continue;
+    fte->referenced = true;
+    for (e = list_begin (&fte->sharers); e != list_end (&fte->sharers);
+         e = list_next (e))
+      list_entry (e, struct spt_entry, frame_elem)->owner->ws_sample++;
+  }
+  pagedir_batch_end ();
+
+  old_level = intr_disable ();
+  thread_foreach (working_set_fold, NULL);
+  intr_set_level (old_level);
+  lock_release (&frame_table_lock);
+}
+
+/* Evicts one of T's own frames, for T is at its resident set
+   limit.  Shared frames and dirty MMAP frames are left for global
+   replacement; if T has nothing else, nothing is evicted. */
+static void
+frame_trim_local (struct thread *t)
+{
+  struct frame_table_entry *victim = NULL;
+  size_t i;
+
+  lock_acquire (&frame_table_lock);
+  pagedir_batch_begin ();
+  for (i = 0; i < 2 * frame_table_size && victim == NULL; i++)
+  {
+    struct frame_table_entry *fte = clock_advance ();
+    struct spt_entry *spte;
+    bool accessed;
+
+    if (fte->frame == NULL || fte->pinned || fte->cleaning
+        || fte->share_cnt != 1 || frame_swap_full (fte))
+      continue;
+    spte = frame_spte (fte);
+    if (spte->owner != t
+        || (spte->type == MMAP && pagedir_is_dirty (t->pagedir, spte->upage)))
+      continue;
+    accessed = frame_accessed (fte) || fte->referenced;
+    fte->referenced = false;
+    if (!accessed)
+      victim = fte;
+  }
+  pagedir_batch_end ();
+  if (victim != NULL)
+  {
+    if (!evict_frame (victim))
+      PANIC ("Not able to evict. ");
+    local_reclaim_cnt++;
+  }
+  lock_release (&frame_table_lock);
+
+  /* Write the victim out, if it went to swap. */
+  clean_dirty_frames ();
+}
+
+/* Sets the resident set limit, in frames, of the processes the
+   current process executes from now on.  0 means no limit. */
+void
+frame_set_rss_limit (size_t limit)
+{
+  thread_current ()->exec_rss_limit = limit;
+}
+
+/* Queues for write-back up to WRITEBACK_BATCH dirty MMAP frames
+   that were already dirty WRITEBACK_AGE ticks ago, and notes when
+   newly dirty frames were first seen.  Returns the number of
+   frames queued. */
+static size_t
+writeback_sweep (void)
+{
+  int64_t now = timer_ticks ();
+  size_t i, queued = 0;
+
+  lock_acquire (&frame_table_lock);
+  for (i = 0; i < frame_table_size && queued < WRITEBACK_BATCH; i++)
+  {
+    struct frame_table_entry *fte = &frame_table[i];
+    struct spt_entry *spte;
+
+    if (fte->frame == NULL || fte->cleaning)
+      continue;
+    spte = frame_spte (fte);
+    if (spte->type != MMAP
+        || !pagedir_is_dirty (spte->owner->pagedir, spte->upage))
+      fte->dirty_since = 0;
+    else if (fte->dirty_since == 0)
+      fte->dirty_since = now;
+    else if (now - fte->dirty_since >= WRITEBACK_AGE)
+    {
+      frame_queue_clean (fte);
+      writeback_cnt++;
+      queued++;
+    }
+  }
+  lock_release (&frame_table_lock);
+  return queued;
+}
+
+/* First step of msync() on user page UPAGE of page directory PD:
+   queues the page for write-back if it is a dirty MMAP page.  If
+   WAIT, first waits for a write-back of the page already under
+   way, since the page may have been dirtied again during it.
+   Returns true if the page was queued. */
+bool
+frame_msync_page (uint32_t *pd, const void *upage, bool wait)
+{
+  struct frame_table_entry *fte;
+  bool queued = false;
+
+  lock_acquire (&frame_table_lock);
+  fte = upage_entry (pd, upage);
+  while (wait && fte != NULL && fte->cleaning)
+  {
+    cond_wait (&cleaning_done, &frame_table_lock);
+    fte = upage_entry (pd, upage);
+  }
+  if (fte != NULL && !fte->cleaning && frame_spte (fte)->type == MMAP
+      && pagedir_is_dirty (pd, upage))
+  {
+    frame_queue_clean (fte);
+    msync_cnt++;
+    queued = true;
+  }
+  lock_release (&frame_table_lock);
+  return queued;
+}
+
+/* Second step of msync(), once its pages are queued.  If SYNC,
+   writes the queued pages back before returning; otherwise leaves
+   them to the pageout daemon.  A page written back by another
+   thread meanwhile is waited for with frame_msync_page(). */
+void
+frame_msync_finish (bool sync)
+{
+  if (sync)
+    clean_dirty_frames ();
+  else
+    pageout_kick ();
+}
+
+/* Waits for an eviction that is in progress to finish.  A page
+   being evicted is unmapped first, so a fault on it can arrive
+   before its supplementary page table entry says where the page
+   has gone. */
+void
+frame_wait_eviction (void)
+{
+  lock_acquire (&frame_table_lock);
+  lock_release (&frame_table_lock);
+}
+
+/* Writes FTE's page back to its file if the owner has dirtied it.
+   Reads from the kernel mapping of the frame, so it works for any
+   owner, not only the current thread. */
+static bool
+write_frame_back (struct frame_table_entry *fte)
+{
+  struct spt_entry *spte = frame_spte (fte);
+  if (!pagedir_is_dirty (spte->owner->pagedir, spte->upage))
+    return true;
+
+  lock_acquire (&file_lock);
+  off_t written = file_write_at (spte->file, fte->frame,
+                                 spte->page_read_bytes, spte->ofs);
+  lock_release (&file_lock);
+  return written == (off_t) spte->page_read_bytes;
+}
+
+/* Writes every frame on the dirty queue out: a MMAP frame back
+   to its file, clearing its dirty bit, and an evicted page to its
+   swap slot, freeing the frame.  The I/O is done without holding
+   frame_table_lock; the frame's cleaning flag keeps it from being
+   evicted or freed meanwhile. */
+static void
+clean_dirty_frames (void)
+{
+  lock_acquire (&frame_table_lock);
+  while (!list_empty (&dirty_queue))
+  {
+    struct frame_table_entry *fte =
+      list_entry (list_pop_front (&dirty_queue),
+                  struct frame_table_entry, clean_elem);
+
+    if (fte->swap_slot != BITMAP_ERROR)
+    {
+      /* No page refers to the frame any more: it only has to be
+         kept until the write is done. */
+      lock_release (&frame_table_lock);
+      swap_write (fte->swap_slot, fte->frame);
+      lock_acquire (&frame_table_lock);
+      fte->swap_slot = BITMAP_ERROR;
+      fte->cleaning = false;
+      clear_frame_entry (fte);
+    }
+    else
+    {
+      struct spt_entry *spte = frame_spte (fte);
+
+      /* Clear first, so a store racing with the write redirties. */
+      pagedir_set_dirty (spte->owner->pagedir, spte->upage, false);
+      lock_release (&frame_table_lock);
+
+      lock_acquire (&file_lock);
+      file_write_at (spte->file, fte->frame, spte->page_read_bytes,
+                     spte->ofs);
+      lock_release (&file_lock);
+
+      lock_acquire (&frame_table_lock);
+      fte->cleaning = false;
+      fte->dirty_since = 0;
+    }
+    cleaning_cnt--;
+    cond_broadcast (&cleaning_done, &frame_table_lock);
+  }
+  lock_release (&frame_table_lock);
+}
+
+/* Unpins user pool page KPAGE, making it a candidate for
+   eviction again. */
+void
+frame_unpin (void *kpage)
+{
+  lock_acquire (&frame_table_lock);
+  frame_entry (kpage)->pinned = false;
+  lock_release (&frame_table_lock);
+}
+
+/* Pins the frame mapped at user address UADDR in page directory
+   PD.  Returns false, without pinning anything, if the page is
+   not resident, or is a writable page still shared after fork()
+   or by the merging scanner; the caller must then load it, which
+   makes a private copy, and try again.  A writable page left
+   mapped read-only, its last sharer being gone, is made writable
+   here.  The kernel writes to the page through the user mapping,
+   and with CR0.WP set a read-only one faults in kernel mode. */
+bool
+frame_pin_upage (uint32_t *pd, const void *uaddr)
+{
+  lock_acquire (&frame_table_lock);
+  struct frame_table_entry *fte = upage_entry (pd, uaddr);
+  if (fte != NULL && frame_spte (fte)->writable
+      && !pagedir_is_writable (pd, uaddr))
+  {
+    if (fte->share_cnt > 1)
+      fte = NULL;
+    else
+      pagedir_set_writable (pd, uaddr, true);
+  }
+  if (fte != NULL)
+    fte->pinned = true;
+  lock_release (&frame_table_lock);
+  return fte != NULL;
+}
+
+/* Unpins the frame mapped at user address UADDR in page directory
+   PD, if there is one. */
+void
+frame_unpin_upage (uint32_t *pd, const void *uaddr)
+{
+  lock_acquire (&frame_table_lock);
+  struct frame_table_entry *fte = upage_entry (pd, uaddr);
+  if (fte != NULL)
+    fte->pinned = false;
+  lock_release (&frame_table_lock);
+}
+
+//Deallocate the frame to free up memory
+void free_frame (void *frame)
+{
+  struct frame_table_entry *fte = frame_entry (frame);
+  lock_acquire (&frame_table_lock);
+  while (fte->cleaning)
+    cond_wait (&cleaning_done, &frame_table_lock);
+  ASSERT (!fte->cached);
+  while (!list_empty (&fte->sharers))
+    sharer_remove (fte, list_entry (list_front (&fte->sharers),
+                                    struct spt_entry, frame_elem));
+  if (fte->hot)
+  {
+    fte->hot = false;
+    hot_cnt--;
+  }
+  fte->frame = NULL;
+  fte->pinned = false;
+  lock_release(&frame_table_lock);
+  palloc_free_page (frame);
+}
+
+/* Unmaps SPTE's page, if it is resident, and frees its frame
+   unless other processes still share it. */
+void
+release_frame_of_page (struct spt_entry *spte)
+{
+  lock_acquire (&frame_table_lock);
+  release_page_locked (spte);
+  lock_release (&frame_table_lock);
+}
+
+/* release_frame_of_page(), with frame_table_lock held. */
+static void
+release_page_locked (struct spt_entry *spte)
+{
+  ASSERT (lock_held_by_current_thread (&frame_table_lock));
+  if (spte->cold)
+  {
+    list_remove (&spte->frame_elem);
+    spte->cold = false;
+  }
+  while (spte->frame != NULL && frame_entry (spte->frame)->cleaning)
+    cond_wait (&cleaning_done, &frame_table_lock);
+  if (spte->frame != NULL)
+  {
+    struct frame_table_entry *fte = frame_entry (spte->frame);
+    pagedir_clear_page (spte->owner->pagedir, spte->upage);
+    sharer_remove (fte, spte);
+    spte->frame = NULL;
+    if (fte->share_cnt == 0)
+    {
+      fte->pinned = false;
+      clear_frame_entry (fte);
+    }
+  }
+}
+
+/* Releases the frames of every page in SPT, the supplementary page
+   table of an exited process, as release_frame_of_page() does.
+   frame_table_lock is taken once for RELEASE_BATCH pages, rather
+   than once a page, and let go in between for faulting threads.
+   Nothing else changes SPT meanwhile. */
+void
+frame_release_spt (struct hash *spt)
+{
+  struct hash_iterator i;
+  int n = 0;
+
+  lock_acquire (&frame_table_lock);
+  hash_first (&i, spt);
+  while (hash_next (&i))
+  {
+    release_page_locked (hash_entry (hash_cur (&i), struct spt_entry, elem));
+    if (++n % RELEASE_BATCH == 0)
+    {
+      lock_release (&frame_table_lock);
+      lock_acquire (&frame_table_lock);
+    }
+  }
+  lock_release (&frame_table_lock);
+}
+
+/* Makes SPTE's page, which fork() left shared and mapped
+   read-only, writable for the current process.  Unless it is the
+   last process sharing the frame, it gets a private copy in a
+   frame of its own.  Returns false if the page was evicted in the
+   meantime; it must then be loaded again.  Also returns false if
+   there is no frame for the copy, the process having been killed
+   for lack of memory. */
+bool
+frame_cow_break (struct spt_entry *spte)
+{
+  uint32_t *pd = spte->owner->pagedir;
+  void *copy = NULL;
+  bool done = false;
+
+  lock_acquire (&frame_table_lock);
+  while (spte->frame != NULL)
+  {
+    struct frame_table_entry *fte = frame_entry (spte->frame);
+    if (fte->share_cnt == 1)
+    {
+      pagedir_set_writable (pd, spte->upage, true);
+      done = true;
+      break;
+    }
+    if (copy != NULL)
+    {
+      struct frame_table_entry *new = frame_entry (copy);
+      memcpy (copy, spte->frame, PGSIZE);
+      sharer_remove (fte, spte);
+      fill_table_details (new, copy, spte);
+      new->pinned = false;
+      new->cleaning = false;
+      spte->frame = copy;
+      copy = NULL;
+
+      pagedir_clear_page (pd, spte->upage);
+      pagedir_set_page (pd, spte->upage, spte->frame, true);
+      cow_copy_cnt++;
+      done = true;
+      break;
+    }
+
+    /* Allocating may evict, so do it without the lock and look
+       again afterwards. */
+    lock_release (&frame_table_lock);
+    copy = frame_alloc (PAL_USER, NULL);
+    lock_acquire (&frame_table_lock);
+    if (copy == NULL)
+      break;
+  }
+  lock_release (&frame_table_lock);
+
+  if (copy != NULL)
+    palloc_free_page (copy);
+  return done;
+}
+
+/* Makes CHILD, the current process's copy of PARENT made by
+   fork(), share PARENT's resident page, mapped read-only in both
+   processes until one writes to it.  Swapped out pages are copied
+   by frame_fork_swap(), and a page that is neither is loaded by
+   each process on its own.  Called with frame_table_lock held, so
+   that no page moves between the two.  Returns false if the
+   child's page table cannot be extended. */
+bool
+frame_fork_page (struct spt_entry *parent, struct spt_entry *child)
+{
+  struct frame_table_entry *fte;
+
+  ASSERT (lock_held_by_current_thread (&frame_table_lock));
+  if (parent->frame == NULL)
+    return true;
+
+  fte = frame_entry (parent->frame);
+  if (!pagedir_set_page (child->owner->pagedir, child->upage,
+                         parent->frame, false))
+    return false;
+  if (parent->writable)
+    pagedir_set_writable (parent->owner->pagedir, parent->upage, false);
+  sharer_add (fte, child);
+  child->frame = parent->frame;
+  fork_share_cnt++;
+  return true;
+}
+
+/* Gives a swap entry in the current process's page table the same
+   swap slot, and reserves swap for the page. */
+static bool
+fork_swap_entry (void *upage, size_t slot, void *aux UNUSED)
+{
+  if (!swap_reserve (thread_current (), 1))
+    return false;
+  if (!pagedir_set_swap (thread_current ()->pagedir, upage, slot))
+  {
+    swap_unreserve (thread_current (), 1);
+    return false;
+  }
+  swap_dup (slot, thread_current ());
+  return true;
+}
+
+/* Copies the swap entries of PARENT_PD into the page table of the
+   current process, made by fork(), sharing their swap slots.  The
+   child has no spt_entry for these pages until it touches them.
+   Called with frame_table_lock held.  Returns false if the child's
+   page table cannot be extended, or there is no swap to reserve
+   for the pages. */
+bool
+frame_fork_swap (uint32_t *parent_pd)
+{
+  ASSERT (lock_held_by_current_thread (&frame_table_lock));
+  return pagedir_for_each_swap (parent_pd, fork_swap_entry, NULL);
+}
+
+/* Acquires and releases frame_table_lock, which keeps every user
+   page where it is while held. */
+void
+frame_table_lock_acquire (void)
+{
+  lock_acquire (&frame_table_lock);
+}
+
+void
+frame_table_lock_release (void)
+{
+  lock_release (&frame_table_lock);
+}
+
+static void
+clear_frame_entry (struct frame_table_entry *fte)
+{
+  ASSERT (lock_held_by_current_thread (&frame_table_lock));
+  void *frame = fte->frame;
+  if (fte->cached)
+  {
+    hash_delete (&text_cache, &fte->cache_elem);
+    fte->cached = false;
+  }
+  if (fte->hot)
+  {
+    fte->hot = false;
+    hot_cnt--;
+  }
+  fte->frame = NULL;
+  list_init (&fte->sharers);
+  fte->share_cnt = 0;
+  palloc_free_page (frame);
+}
+
+/* Maps SPTE, a read-only page of an executable, to the frame that
+   already holds it for another process, if there is one.  Returns
+   false if the page is not in the text page cache. */
+bool
+frame_cache_share (struct spt_entry *spte)
+{
+  struct frame_table_entry key;
+  struct hash_elem *e;
+  bool shared = false;
+
+  key.inode = file_get_inode (spte->file);
+  key.ofs = spte->ofs;
+
+  lock_acquire (&frame_table_lock);
+  e = hash_find (&text_cache, &key.cache_elem);
+  if (e != NULL)
+  {
+    struct frame_table_entry *fte =
+      hash_entry (e, struct frame_table_entry, cache_elem);
+    if (pagedir_set_page (spte->owner->pagedir, spte->upage, fte->frame,
+                          false))
+    {
+      sharer_add (fte, spte);
+      spte->frame = fte->frame;
+      text_cache_hit_cnt++;
+      shared = true;
+    }
+  }
+  lock_release (&frame_table_lock);
+  return shared;
+}
+
+/* Adds FRAME, just loaded with SPTE's read-only executable page,
+   to the text page cache.  If another process loaded the same page
+   at the same time, FRAME stays private. */
+void
+frame_cache_add (void *frame, struct spt_entry *spte)
+{
+  struct frame_table_entry *fte = frame_entry (frame);
+
+  lock_acquire (&frame_table_lock);
+  fte->inode = file_get_inode (spte->file);
+  fte->ofs = spte->ofs;
+  if (hash_insert (&text_cache, &fte->cache_elem) == NULL)
+    fte->cached = true;
+  lock_release (&frame_table_lock);
+}
+
+/* Returns the text page cache hash of the page in FTE. */
+static unsigned
+text_cache_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct frame_table_entry *fte =
+    hash_entry (e, struct frame_table_entry, cache_elem);
+  return hash_bytes (&fte->inode, sizeof fte->inode) ^ hash_int (fte->ofs);
+}
+
+/* Orders text page cache entries by inode, then offset. */
+static bool
+text_cache_less (const struct hash_elem *a_, const struct hash_elem *b_,
+                 void *aux UNUSED)
+{
+  const struct frame_table_entry *a =
+    hash_entry (a_, struct frame_table_entry, cache_elem);
+  const struct frame_table_entry *b =
+    hash_entry (b_, struct frame_table_entry, cache_elem);
+  if (a->inode != b->inode)
+    return a->inode < b->inode;
+  return a->ofs < b->ofs;
+}
+
+/* Page merging scanner.  Sleeps MERGE_INTERVAL ticks, then scans
+   the next MERGE_BATCH frames.  It runs at the lowest priority, so
+   it only takes time no one else wants. */
+static void
+merge_daemon (void *aux UNUSED)
+{
+  for (;;)
+  {
+    uint64_t start;
+    int i;
+
+    timer_sleep (MERGE_INTERVAL);
+    start = rdtsc ();
+    for (i = 0; i < MERGE_BATCH; i++)
+      merge_scan_frame ();
+    merge_cycles += rdtsc () - start;
+  }
+}
+
+/* Returns true if the scanner may merge the page in FTE: an
+   anonymous page, either a CODE page or a writable page of an
+   executable's data, that is not being loaded, written back or
+   used by the kernel, and is mapped with small pages only. */
+static bool
+merge_candidate (struct frame_table_entry *fte)
+{
+  struct list_elem *e;
+
+  if (fte->frame == NULL || fte->pinned || fte->cleaning || fte->cached)
+    return false;
+  for (e = list_begin (&fte->sharers); e != list_end (&fte->sharers);
+       e = list_next (e))
+  {
+    struct spt_entry *s = list_entry (e, struct spt_entry, frame_elem);
+    if (!(s->type == CODE || (s->type == FILE && s->writable))
+        || pagedir_is_large (s->owner->pagedir, s->upage))
+      return false;
+  }
+  return true;
+}
+
+/* Hashes the frame under the scanner's hand, and merges it into a
+   frame hashed earlier in the pass if their hashes are equal. */
+static void
+merge_scan_frame (void)
+{
+  struct frame_table_entry *fte;
+  struct hash_elem *e;
+  void *frame;
+  unsigned sum = 0;
+
+  lock_acquire (&frame_table_lock);
+  fte = &frame_table[merge_hand];
+  frame = merge_candidate (fte) ? fte->frame : NULL;
+  lock_release (&frame_table_lock);
+
+  /* Hash without the lock.  The page may change meanwhile, so
+     merge_frames() compares the contents again before merging. */
+  if (frame != NULL)
+    sum = hash_bytes (frame, PGSIZE);
+
+  lock_acquire (&frame_table_lock);
+  if (frame != NULL && fte->frame == frame && merge_candidate (fte))
+  {
+    merge_scan_cnt++;
+    fte->merge_sum = sum;
+    e = hash_insert (&merge_table, &fte->merge_elem);
+    if (e != NULL)
+      merge_frames (hash_entry (e, struct frame_table_entry, merge_elem),
+                    fte);
+  }
+  merge_hand = (merge_hand + 1) % frame_table_size;
+  if (merge_hand == 0)
+  {
+    hash_clear (&merge_table, NULL);
+    merge_pass++;
+    cond_broadcast (&merge_pass_done, &frame_table_lock);
+  }
+  lock_release (&frame_table_lock);
+}
+
+/* Maps the page of every process sharing FTE read-only.  Returns
+   true if any of them was writable, which a page only is while a
+   single process maps it. */
+static bool
+merge_protect (struct frame_table_entry *fte)
+{
+  struct list_elem *e;
+  bool was_writable = false;
+
+  for (e = list_begin (&fte->sharers); e != list_end (&fte->sharers);
+       e = list_next (e))
+  {
+    struct spt_entry *s = list_entry (e, struct spt_entry, frame_elem);
+    if (pagedir_is_writable (s->owner->pagedir, s->upage))
+    {
+      pagedir_set_writable (s->owner->pagedir, s->upage, false);
+      was_writable = true;
+    }
+  }
+  return was_writable;
+}
+
+/* Maps the page in FTE writable again, after merge_protect() found
+   it writable. */
+static void
+merge_unprotect (struct frame_table_entry *fte)
+{
+  struct spt_entry *s = frame_spte (fte);
+
+  ASSERT (fte->share_cnt == 1);
+  pagedir_set_writable (s->owner->pagedir, s->upage, true);
+}
+
+/* Merges DUP into KEEP if the two frames hold the same contents:
+   the processes sharing DUP map KEEP read-only instead, and DUP is
+   freed.  Both frames are write protected before they are
+   compared, so that neither can change afterwards.  If they differ,
+   the pages that were writable are made writable again: a kernel
+   write through the user mapping takes no write fault to do it.
+   Returns true if the frames were merged.  Called with
+   frame_table_lock held. */
+static bool
+merge_frames (struct frame_table_entry *keep, struct frame_table_entry *dup)
+{
+  bool keep_writable, dup_writable;
+
+  ASSERT (lock_held_by_current_thread (&frame_table_lock));
+
+  if (!merge_candidate (keep))
+    return false;
+  keep_writable = merge_protect (keep);
+  dup_writable = merge_protect (dup);
+  if (memcmp (keep->frame, dup->frame, PGSIZE) != 0)
+  {
+    if (keep_writable)
+      merge_unprotect (keep);
+    if (dup_writable)
+      merge_unprotect (dup);
+    return false;
+  }
+
+  /* The page table entries exist, since the pages are mapped, so
+     mapping KEEP cannot fail. */
+  while (!list_empty (&dup->sharers))
+  {
+    struct spt_entry *s = list_entry (list_front (&dup->sharers),
+                                      struct spt_entry, frame_elem);
+    pagedir_clear_page (s->owner->pagedir, s->upage);
+    if (!pagedir_set_page (s->owner->pagedir, s->upage, keep->frame, false))
+      PANIC ("Not able to map merged page");
+    sharer_remove (dup, s);
+    sharer_add (keep, s);
+    s->frame = keep->frame;
+  }
+  keep->merged = true;
+  clear_frame_entry (dup);
+  merge_cnt++;
+  return true;
+}
+
+/* Waits until the page merging scanner has made a full pass over
+   the frame table that started after the call, so that every page
+   the caller wrote before has been looked at.  Returns at once if
+   merging is off. */
+void
+frame_merge_wait (void)
+{
+  long long pass;
+
+  if (!frame_merge)
+    return;
+  lock_acquire (&frame_table_lock);
+  pass = merge_pass + (merge_hand != 0 ? 2 : 1);
+  while (merge_pass < pass)
+    cond_wait (&merge_pass_done, &frame_table_lock);
+  lock_release (&frame_table_lock);
+}
+
+/* Fills in ST with page merging statistics.  The frames merged
+   pages are in now are counted from the frame table. */
+void
+frame_merge_stats (struct merge_stats *st)
+{
+  size_t i;
+
+  st->shared = st->sharing = 0;
+  lock_acquire (&frame_table_lock);
+  for (i = 0; i < frame_table_size; i++)
+  {
+    struct frame_table_entry *fte = &frame_table[i];
+    if (fte->frame != NULL && fte->merged && fte->share_cnt > 1)
+    {
+      st->shared++;
+      st->sharing += fte->share_cnt - 1;
+    }
+  }
+  st->merged = merge_cnt;
+  st->scanned = merge_scan_cnt;
+  st->scan_cycles = merge_cycles;
+  lock_release (&frame_table_lock);
+}
+
+/* Returns the scanner's hash of the contents of the page in FTE. */
+static unsigned
+merge_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_entry (e, struct frame_table_entry, merge_elem)->merge_sum;
+}
+
+/* Orders frames in the scanner's hash table by content hash. */
+static bool
+merge_less (const struct hash_elem *a_, const struct hash_elem *b_,
+            void *aux UNUSED)
+{
+  return hash_entry (a_, struct frame_table_entry, merge_elem)->merge_sum
+         < hash_entry (b_, struct frame_table_entry, merge_elem)->merge_sum;
 }
@@ -1,26 +1,86 @@
 #ifndef VM_FRAME
 #define VM_FRAME
 
+#include <hash.h>
 #include <list.h>
 #include "vm/page.h"
 #include "threads/thread.h"
 #include "threads/palloc.h"
+#include "threads/pte.h"
 
 
-//Defining the structure for a frame table entry
+/* Defining the structure for a frame table entry.  There is one
+   per user pool frame; FRAME is null while the frame is free.
+   After fork() a frame can hold the same page for several
+   processes, each with its own spt_entry on SHARERS; the page is
+   mapped read-only in all of them until it is written. */
 struct frame_table_entry
 {
-  void *frame;
-  struct spt_entry *spte;
-  struct thread *t;
-  struct list_elem elem;  //Pointer to elements in frame table list
+  void *frame;            /* Kernel virtual address of the frame. */
+  struct list sharers;    /* spt_entry's of the page held in the frame. */
+  int share_cnt;          /* Number of entries in SHARERS. */
+  bool cached;            /* In the text page cache, under INODE, OFS. */
+  struct inode *inode;    /* File the page was read from. */
+  off_t ofs;              /* Offset of the page in INODE. */
+  struct hash_elem cache_elem;  /* Element in the text page cache. */
+  bool referenced;        /* Accessed bit seen by working set sampling. */
+  bool hot;               /* 2Q: re-faulted soon after eviction. */
+  bool pinned;            /* Must not be evicted. */
+  bool cleaning;          /* Queued for, or under, write-back. */
+  size_t swap_slot;       /* While cleaning, the swap slot the page is
+                             written to, or BITMAP_ERROR for write-back
+                             of a MMAP page to its file. */
+  struct list_elem clean_elem;  /* Element in the dirty frame queue. */
+  int64_t dirty_since;    /* Tick the writeback thread saw it dirty, or 0. */
+  bool merged;            /* Shared by same-page merging. */
+  unsigned merge_sum;     /* Hash of the contents when last scanned. */
+  struct hash_elem merge_elem;  /* Element in the scanner's hash table. */
 };
 
 
+/* Page replacement policies, chosen with -rp on the kernel command
+   line. */
+enum frame_policy
+  {
+    POLICY_CLOCK,           /* Second chance (default). */
+    POLICY_2Q               /* Scan resistant 2Q. */
+  };
+extern enum frame_policy frame_policy;
+
+/* -merge: merge frames with the same contents? */
+extern bool frame_merge;
+
+/* Frames in a large page. */
+#define LARGE_PAGE_CNT (PTSPAN / PGSIZE)
+
 //Function declarations
-static void frame_table_add (void *, struct spt_entry *);
 void free_frame (void *);
 void frame_table_init (void);
 void *retrieve_frame_of_page (enum palloc_flags, struct spt_entry *);
+void frame_table_add (void *, struct spt_entry *);
+void *frame_alloc_large (void);
+struct frame_table_entry *frame_lookup (void *);
+void frame_unpin (void *);
+bool frame_pin_upage (uint32_t *, const void *);
+void frame_unpin_upage (uint32_t *, const void *);
+void frame_wait_eviction (void);
+void release_frame_of_page (struct spt_entry *);
+void frame_release_spt (struct hash *);
+struct spt_entry *frame_pop_cold (void);
+bool frame_cow_break (struct spt_entry *);
+bool frame_fork_page (struct spt_entry *, struct spt_entry *);
+bool frame_fork_swap (uint32_t *);
+void frame_table_lock_acquire (void);
+void frame_table_lock_release (void);
+bool frame_cache_share (struct spt_entry *);
+void frame_cache_add (void *, struct spt_entry *);
+bool frame_plenty (void);
+void pageout_start (void);
+bool frame_msync_page (uint32_t *, const void *, bool);
+void frame_msync_finish (bool);
+void frame_set_rss_limit (size_t);
+void frame_merge_wait (void);
+void frame_merge_stats (struct merge_stats *);
+void frame_print_stats (void);
 
 #endif
@@ -0,0 +1,105 @@
+#include "vm/oom.h"
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+
+/* Ticks a killed process gets to exit and free its memory before
+   another one is killed in its place. */
+#define OOM_GRACE TIMER_FREQ
+
+/* Statistics. */
+static long long oom_kill_cnt;
+
+/* Result of scanning the processes for a victim. */
+struct oom_scan
+  {
+    struct thread *victim;      /* Process with the largest footprint. */
+    size_t rss, swap;           /* Its frames and swapped out pages. */
+    bool dying;                 /* Some process is freeing its memory. */
+    bool waiting;               /* A killed one is in its grace period. */
+  };
+
+static void oom_scan_thread (struct thread *, void *);
+
+/* Frees memory when nothing more can be evicted: kills the user
+   process with the largest footprint, resident frames and swapped
+   out pages together, which exits with status -1 the next time it
+   faults, makes a system call or allocates a frame.  If a process
+   killed earlier is still exiting, waits for it instead, giving it
+   OOM_GRACE ticks before killing another, and waits as well for
+   exited processes whose memory the reaper has yet to free.  The
+   caller releases its locks and tries its allocation again; if it
+   is the victim itself, it gives up.  Returns false if there is
+   no process to kill or wait for.  Called with the frame table
+   lock held, which keeps the resident set sizes still. */
+bool
+oom_kill (void)
+{
+  struct oom_scan s;
+  enum intr_level old_level;
+  char name[16], *save_ptr;
+  tid_t tid;
+
+  s.victim = NULL;
+  s.rss = s.swap = 0;
+  s.dying = s.waiting = false;
+
+  old_level = intr_disable ();
+  thread_foreach (oom_scan_thread, &s);
+  if (s.waiting || s.victim == NULL)
+  {
+    intr_set_level (old_level);
+    return s.dying;
+  }
+  s.victim->oom_killed = true;
+  s.victim->oom_kill_tick = timer_ticks ();
+  tid = s.victim->tid;
+  strlcpy (name, s.victim->name, sizeof name);
+  intr_set_level (old_level);
+
+  oom_kill_cnt++;
+  printf ("Out of memory: killed process %d (%s), %zu frames, "
+          "%zu pages in swap\n", tid, strtok_r (name, " ", &save_ptr),
+          s.rss, s.swap);
+  return true;
+}
+
+/* Scores T for oom_kill(), whose scan is AUX. */
+static void
+oom_scan_thread (struct thread *t, void *aux)
+{
+  struct oom_scan *s = aux;
+
+  /* Kernel threads, and processes whose memory the reaper is
+     freeing already. */
+  if (t->pagedir == NULL)
+    return;
+  if (t->reap_queued)
+  {
+    s->dying = true;
+    return;
+  }
+  if (t->oom_killed)
+  {
+    s->dying = true;
+    if (timer_elapsed (t->oom_kill_tick) < OOM_GRACE)
+      s->waiting = true;
+    return;
+  }
+
+  if (s->victim == NULL || t->rss + t->swap_cnt > s->rss + s->swap)
+  {
+    s->victim = t;
+    s->rss = t->rss;
+    s->swap = t->swap_cnt;
+  }
+}
+
+/* Prints OOM killer statistics. */
+void
+oom_print_stats (void)
+{
+  printf ("OOM: %lld processes killed\n", oom_kill_cnt);
+}
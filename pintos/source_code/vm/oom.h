@@ -0,0 +1,9 @@
+#ifndef VM_OOM
+#define VM_OOM
+
+#include <stdbool.h>
+
+bool oom_kill (void);
+void oom_print_stats (void);
+
+#endif
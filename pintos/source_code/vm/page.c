@@ -1,24 +1,178 @@
 #include "vm/page.h"
-#include <malloc.h>
+#include "userprog/pagedir.h"
+#include <stdio.h>
+#include <string.h>
+#include <round.h>
+#include "threads/malloc.h"
 #include <bitmap.h>
 #include "threads/synch.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "threads/palloc.h"
+#include "threads/init.h"
+#include "threads/pte.h"
 #include "userprog/process.h"
 #include "filesys/file.h"
+#include "vm/frame.h"
+#include "vm/swap.h"
+#include "vm/vma.h"
+#include <mman.h>
+
+/* Fault-around: on a fault on a read-only executable page, the
+   other pages of its aligned block of this many pages are mapped
+   too if they are already in the text page cache. */
+#define FAULT_AROUND_PAGES 8
+
+/* Stack growth: once faults show the stack growing down a page at
+   a time, each growth fault maps this many pages below the faulting
+   one as well, starting at STACK_CHUNK_MIN and doubling with every
+   further growth fault, up to STACK_CHUNK_MAX. */
+#define STACK_CHUNK_MIN 2
+#define STACK_CHUNK_MAX 16
+
+/* Readahead window, in pages, when faults on FILE and MMAP pages
+   are sequential.  It starts at RA_MIN_PAGES and doubles with every
+   further sequential fault, up to RA_MAX_PAGES. */
+#define RA_MIN_PAGES 2
+#define RA_MAX_PAGES 16
+
+/* Frame of zeros shared, read-only, by every anonymous or bss
+   page that has only been read so far.  It comes from the kernel
+   pool, so it is never in the frame table or evicted. */
+static void *zero_page;
+
+/* Zero page mappings made, and broken by a first write. */
+static long long zero_map_cnt;
+static long long zero_break_cnt;
+
+/* Pages mapped by fault-around and read by readahead. */
+static long long fault_around_cnt;
+static long long readahead_cnt;
+
+/* Faults on file pages that had been dropped from memory. */
+static long long refault_cnt;
+
+/* Pages read in and thrown away on madvise(). */
+static long long willneed_cnt;
+static long long dontneed_cnt;
+
+/* Large pages mapped. */
+static long long large_map_cnt;
+
+/* Stack pages mapped on a fault, ahead of the faults and at exec. */
+static long long stack_fault_cnt;
+static long long stack_ahead_cnt;
+static long long stack_exec_cnt;
+
+/* Entries of evicted pages freed. */
+static long long cold_free_cnt;
 
 //Function declarations
 static struct spt_entry* create_spte ();
+static struct spt_entry *spt_lookup (void *);
 static bool install_load_file (struct spt_entry *);
+static bool load_file_page (struct spt_entry *);
+static void file_readahead (struct spt_entry *);
 static bool install_load_mmap (struct spt_entry *);
 static bool install_load_swap (struct spt_entry *);
-static void free_spte_elem (struct hash_elem *, void *);
+static bool install_large_page (struct spt_entry *);
+static bool stack_map_page (void *);
+static void free_stack_spte (struct spt_entry *);
+static bool spte_swap_slot (struct spt_entry *, size_t *);
 static void free_spte (struct spt_entry *);
+static void write_back_mmap_elem (struct hash_elem *, void *);
+static bool prefetch_page (struct spt_entry *);
+static void discard_page (void *);
+
+//Allocate the shared zero page
+void page_init (void)
+{
+  zero_page = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+}
+
+//Print zero page statistics
+void page_print_stats (void)
+{
+  printf ("Zero page: %lld mappings, %lld broken by a write\n",
+          zero_map_cnt, zero_break_cnt);
+  printf ("File pages: %lld mapped by fault-around, %lld read ahead, "
+          "%lld refaults\n", fault_around_cnt, readahead_cnt, refault_cnt);
+  printf ("madvise: %lld pages read in, %lld thrown away\n",
+          willneed_cnt, dontneed_cnt);
+  printf ("Large pages: %lld mapped, %lld split\n",
+          large_map_cnt, pagedir_split_cnt ());
+  printf ("Stack: %lld pages grown on a fault, %lld ahead of faults, "
+          "%lld at exec\n", stack_fault_cnt, stack_ahead_cnt, stack_exec_cnt);
+  printf ("Page entries: %lld freed after eviction\n", cold_free_cnt);
+}
+
+//Check whether kernel page is the shared zero page
+bool is_zero_page (const void *kpage)
+{
+  return kpage == zero_page;
+}
+
+/* Loads the page for a read access.  A page that would read as
+   all zeros, an anonymous page never swapped out or a bss page,
+   gets the shared zero page mapped read-only instead of a frame of
+   its own; the first write to it faults and loads it properly. */
+bool install_load_page_read (struct spt_entry *spte)
+{
+  size_t slot;
+  bool zero = (spte->type == CODE && !spte_swap_slot (spte, &slot))
+              || (spte->type == FILE && spte->page_read_bytes == 0);
+  if (!zero || spte->frame != NULL || spte->zero_mapped)
+    return install_load_page (spte);
+  if (install_large_page (spte))
+    return true;
+
+  if (!install_page (spte->upage, zero_page, false))
+    return false;
+  spte->zero_mapped = true;
+  zero_map_cnt++;
+  return true;
+}
+
+/* Returns the class of a fault on SPTE, a page that is not
+   present, for the fault statistics. */
+enum fault_class page_fault_class (struct spt_entry *spte)
+{
+  size_t slot;
+
+  if (spte->type == MMAP)
+    return FAULT_MMAP;
+  else if (spte->type == FILE && spte->page_read_bytes > 0)
+    return FAULT_FILE;
+  else if (spte->type == CODE && spte_swap_slot (spte, &slot))
+    return FAULT_SWAP;
+  else
+    return FAULT_ANON;
+}
 
 //Parent function for loading page according to the function, i.e files,mmap or swap
 bool install_load_page (struct spt_entry *spte)
 {
+  /* The page may be on its way out to swap or to its file. */
+  frame_wait_eviction ();
+
+  /* Copy-on-write: trade the zero page for a frame of its own. */
+  if (spte->zero_mapped)
+  {
+    pagedir_clear_page (thread_current ()->pagedir, spte->upage);
+    spte->zero_mapped = false;
+    zero_break_cnt++;
+  }
+  /* Copy-on-write after fork(): take a private copy of a shared
+     frame.  If it was evicted meanwhile, load it as usual. */
+  else if (spte->frame != NULL && frame_cow_break (spte))
+    return true;
+
+  /* Killed for lack of memory: no frame is to be had. */
+  if (thread_current ()->oom_killed)
+    return false;
+
+  if (install_large_page (spte))
+    return true;
   if (spte->type == FILE)
     return install_load_file (spte);
   else if (spte->type == MMAP)
@@ -61,57 +215,48 @@ void supp_page_table_init (struct hash *supp_page_table)
   hash_init (supp_page_table, supp_hashing, cmp_spt, NULL);
 }
 
+/* Returns true if SPTE is an anonymous page, which may have to go
+   to swap: a CODE page, or a writable page of an executable.  Each
+   one holds a swap reservation of the process. */
+static bool spte_anon (struct spt_entry *spte)
+{
+  return spte->type == CODE || (spte->type == FILE && spte->writable);
+}
+
 //Create spte entry for code
 struct spt_entry *create_spte_code (void *upage)
 {
   struct spt_entry *spte = create_spte ();
+  if (spte == NULL)
+    return NULL;
+  if (!swap_reserve (thread_current (), 1))
+  {
+    free (spte);
+    return NULL;
+  }
   spte->upage = upage;
   spte->type = CODE;
+  spte->writable = true;
   hash_insert (&((thread_current())->supp_page_table), &spte->elem);
   return spte;
 }
 
-//Create spte entry for memory mapped files
-struct spt_entry *create_spte_mmap (struct file *f, int read_bytes, void *upage)
+/* Create the region for mapping READ_BYTES bytes of file F at
+   UPAGE.  Its pages get their spt_entry when first touched.
+   Returns NULL if the region would overlap another one. */
+struct vma *create_vma_mmap (struct file *f, int read_bytes, void *upage)
 {
   struct thread *t = thread_current();
-  uint32_t page_read_bytes, page_zero_bytes;
-  int ofs = 0;
-  int i = 0;
-  struct spt_entry *first_spte = NULL;
-  
-  while (read_bytes > 0)
-  {
-    page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
-    page_zero_bytes = PGSIZE - page_read_bytes;
+  void *end = upage + ROUND_UP (read_bytes, PGSIZE);
 
-    struct spt_entry *spte = uvaddr_to_spt_entry (upage);
-    if (spte != NULL){
-      free_spte_mmap (first_spte);
-      return NULL;
-    }
-    spte = create_spte ();
-    spte->type = MMAP;
-    spte_details(spte,upage,f,ofs,page_zero_bytes,page_read_bytes);
-    ofs += page_read_bytes;
-    read_bytes -= page_read_bytes;
-    upage += PGSIZE;
-    
-    hash_insert (&(t->supp_page_table), &spte->elem);
-    if (i == 0)
-    {
-      first_spte = spte;
-      i++;
-    }
-    
-  }
-  return first_spte;
+  if (read_bytes <= 0 || !is_user_vaddr (end - 1) || end < upage)
+    return NULL;
+  return vma_create (&t->vma_root, upage, end, MMAP, f, 0, read_bytes, true);
 }
 
-//Map user virtual address to spte entry
-struct spt_entry * uvaddr_to_spt_entry (void *uvaddr)
+//Find the spte entry of a user page, if it has been created
+static struct spt_entry *spt_lookup (void *upage)
 {
-  void *upage = pg_round_down (uvaddr);
   struct spt_entry spte;
   spte.upage = upage;
 
@@ -121,37 +266,105 @@ struct spt_entry * uvaddr_to_spt_entry (void *uvaddr)
   else return hash_entry (e, struct spt_entry, elem);
 }
 
+/* Creates the spt_entry of page UPAGE of region VMA, which is
+   being touched for the first time. */
+static struct spt_entry *create_spte_vma (struct vma *vma, void *upage)
+{
+  struct spt_entry *spte = create_spte ();
+  if (spte == NULL)
+    return NULL;
+
+  uint32_t page_ofs = (uint8_t *) upage - vma->start;
+  uint32_t page_read_bytes = 0;
+  if (page_ofs < vma->read_bytes)
+    page_read_bytes = vma->read_bytes - page_ofs < PGSIZE
+                      ? vma->read_bytes - page_ofs : PGSIZE;
+
+  spte->type = vma->type;
+  spte_details (spte, upage, vma->file, vma->ofs + page_ofs,
+                PGSIZE - page_read_bytes, page_read_bytes);
+  spte->writable = vma->writable;
+  if (spte_anon (spte) && !swap_reserve (thread_current (), 1))
+  {
+    free (spte);
+    return NULL;
+  }
+  spte->vma = vma;
+  list_push_back (&vma->pages, &spte->vma_elem);
+  hash_insert (&thread_current ()->supp_page_table, &spte->elem);
+  return spte;
+}
+
+/* Map user virtual address to spte entry.  The entry of a page in
+   a file-backed region is created on first use, and so is the
+   entry of a page that fork() left only in the page table, as a
+   swap entry; fork() reserved swap for that page already. */
+struct spt_entry * uvaddr_to_spt_entry (void *uvaddr)
+{
+  struct thread *t = thread_current ();
+  void *upage = pg_round_down (uvaddr);
+  struct spt_entry *spte = spt_lookup (upage);
+  size_t slot;
+  if (spte != NULL)
+    return spte;
+
+  struct vma *vma = vma_find (t->vma_root, upage);
+  if (pagedir_get_swap (t->pagedir, upage, &slot))
+  {
+    spte = create_spte ();
+    if (spte == NULL)
+      return NULL;
+    spte->upage = upage;
+    spte->type = CODE;
+    spte->writable = true;
+    if (vma != NULL)
+    {
+      spte->vma = vma;
+      list_push_back (&vma->pages, &spte->vma_elem);
+    }
+    hash_insert (&t->supp_page_table, &spte->elem);
+    return spte;
+  }
+
+  /* The stack region only reserves address space; its pages are
+     created by stack_increase(). */
+  if (vma == NULL || vma->type == CODE)
+    return NULL;
+  return create_spte_vma (vma, upage);
+}
+
+/* If the page of SPTE is swapped out, stores its swap slot, which
+   the page table entry holds, in *SLOT and returns true. */
+static bool spte_swap_slot (struct spt_entry *spte, size_t *slot)
+{
+  return spte->frame == NULL
+         && pagedir_get_swap (spte->owner->pagedir, spte->upage, slot);
+}
+
 //Dynamically create a spte entry
 static struct spt_entry *create_spte ()
 {
   struct spt_entry *spte = (struct spt_entry *) malloc (sizeof (struct spt_entry));
+  if (spte == NULL)
+    return NULL;
+  spte->owner = thread_current ();
   spte->upage = NULL;
   spte->frame = NULL;
-  spte->is_in_swap = false;
-  spte->idx = BITMAP_ERROR;
-  spte->pinned = false;
+  spte->zero_mapped = false;
+  spte->cold = false;
+  spte->vma = NULL;
   return spte;
 }
 
-//Create the spte entries and populate the table
+//Create the region of an executable segment; its pages are created when touched
 bool file_supp_creation (struct file *file, off_t ofs, uint8_t *upage, uint32_t read_bytes, uint32_t zero_bytes, bool writable) 
 {
   ASSERT (ofs % PGSIZE == 0&&pg_ofs (upage) == 0&&(read_bytes + zero_bytes) % PGSIZE == 0);
-  while ( zero_bytes > 0 || read_bytes > 0) 
-  {
-      size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
-      size_t page_zero_bytes = PGSIZE - page_read_bytes;
-      struct spt_entry *spte = create_spte ();
-      spte->type = FILE;
-      spte_details(spte,upage,file,ofs,page_zero_bytes,page_read_bytes);
-      spte->writable = writable;
-      ofs += page_read_bytes;
-      read_bytes -= page_read_bytes;
-      zero_bytes -= page_zero_bytes;
-      upage += PGSIZE;
-      hash_insert (&((thread_current())->supp_page_table), &spte->elem);
-  }
-  return true;
+  if (read_bytes + zero_bytes == 0)
+    return true;
+  return vma_create (&thread_current ()->vma_root, upage,
+                     upage + read_bytes + zero_bytes, FILE, file, ofs,
+                     read_bytes, writable) != NULL;
 }
 
 //Helper for loading page for memory mapped files
@@ -163,40 +376,119 @@ static bool install_load_mmap (struct spt_entry *spte)
 //Load the page for swap table
 static bool install_load_swap (struct spt_entry *spte)
 {
+  /* Mapping the frame overwrites the swap entry. */
+  size_t slot;
+  bool in_swap = spte_swap_slot (spte, &slot);
   void *frame = retrieve_frame_of_page (PAL_USER | PAL_ZERO, spte);
-  ASSERT (frame != NULL);
 
   if (frame == NULL) return false;
   if (install_page (spte->upage, frame, true))
   {
     spte->frame = frame;
-    if (spte->is_in_swap)
-    {
-      swap_in (spte);
-      spte->is_in_swap = false;
-      spte->idx = BITMAP_ERROR;
-    }
+    if (in_swap)
+      swap_in (spte, slot);
+    frame_unpin (frame);
     return true;
   }
   else free_frame (frame);
   return false;
 }
 
-//Aids in unmapping the file from supp. table
-void free_spte_mmap (struct spt_entry *first_spte)
+/* Large pages: a fault in a writable region advised MADV_HUGEPAGE
+   loads the whole aligned 4 MB block around the faulting page at
+   once and maps it with a single large page, if the block lies
+   within the region, nothing in it is mapped or swapped out yet,
+   and enough contiguous frames are free.  Returns false, having
+   changed nothing the caller can see, if any of that fails; the
+   page is then loaded on its own.  Each frame of the block is in
+   the frame table with its own spt_entry, so eviction, munmap()
+   and the rest work on the pages as usual, splitting the large
+   page first. */
+static bool install_large_page (struct spt_entry *spte)
 {
-  if (first_spte != NULL)
+  struct thread *t = thread_current ();
+  struct vma *vma = spte->vma;
+  uint8_t *block = (uint8_t *) ((uintptr_t) spte->upage
+                                & ~(uintptr_t) (PTSPAN - 1));
+  uint8_t *kpage;
+  bool ok = true;
+  size_t i;
+
+  if (!large_pages || vma == NULL || !vma->huge || !vma->writable
+      || vma->type == CODE || block < vma->start
+      || (size_t) (vma->end - block) < PTSPAN
+      || !pagedir_block_unused (t->pagedir, block))
+    return false;
+
+  /* Every page needs its spt_entry before any frame is taken. */
+  for (i = 0; i < LARGE_PAGE_CNT; i++)
+    if (uvaddr_to_spt_entry (block + i * PGSIZE) == NULL)
+      return false;
+
+  kpage = frame_alloc_large ();
+  if (kpage == NULL)
+    return false;
+
+  /* Nothing in the block is mapped or in swap, so each page is what
+     its region says: file data, if any, then zeros. */
+  lock_acquire (&file_lock);
+  for (i = 0; i < LARGE_PAGE_CNT && ok; i++)
   {
-    int read_bytes = file_length (first_spte->file);
-    void *upage = first_spte->upage;
-    struct spt_entry *spte;
-    while (read_bytes > 0)
-    {
-      spte = uvaddr_to_spt_entry (upage);
-      upage += PGSIZE;
-      read_bytes -= spte->page_read_bytes;
-      if (spte->file == first_spte->file) free_spte (spte);
-    }
+    struct spt_entry *s = spt_lookup (block + i * PGSIZE);
+    uint8_t *frame = kpage + i * PGSIZE;
+    uint32_t read_bytes = s->type != CODE ? s->page_read_bytes : 0;
+
+    if (read_bytes > 0
+        && file_read_at (s->file, frame, read_bytes, s->ofs)
+           != (off_t) read_bytes)
+      ok = false;
+    memset (frame + read_bytes, 0, PGSIZE - read_bytes);
+  }
+  lock_release (&file_lock);
+  if (!ok)
+  {
+    palloc_free_multiple (kpage, LARGE_PAGE_CNT);
+    return false;
+  }
+
+  for (i = 0; i < LARGE_PAGE_CNT; i++)
+  {
+    struct spt_entry *s = spt_lookup (block + i * PGSIZE);
+    s->frame = kpage + i * PGSIZE;
+    frame_table_add (s->frame, s);
+  }
+  pagedir_set_large_page (t->pagedir, block, kpage, true);
+  for (i = 0; i < LARGE_PAGE_CNT; i++)
+    frame_unpin (kpage + i * PGSIZE);
+  large_map_cnt++;
+  return true;
+}
+
+//Aids in unmapping the file: frees the pages touched so far, then the region
+void free_vma_mmap (struct vma *vma)
+{
+  struct thread *t = thread_current ();
+
+  while (vma != NULL)
+  {
+    struct file *file = vma->file;
+    struct vma *next = vma_find (t->vma_root, vma->end);
+
+    /* madvise() may have split the mapping: the rest of it follows
+       on, in regions of the same file. */
+    if (next != NULL && (next->type != MMAP || next->file != file))
+      next = NULL;
+
+    while (!list_empty (&vma->pages))
+      free_spte (list_entry (list_front (&vma->pages), struct spt_entry, vma_elem));
+    vma_remove (&t->vma_root, vma);
+
+    /* The file mmap() reopened, or fork() or a split took a
+       reference to. */
+    lock_acquire (&file_lock);
+    file_close (file);
+    lock_release (&file_lock);
+    vma = next;
   }
 }
 
@@ -219,23 +511,125 @@ static void free_spte (struct spt_entry *spte)
 {
   if (spte != NULL)
   {
-    if (spte->frame != NULL)
-    {
-      if(spte->type == MMAP || (spte->type == FILE && spte->writable)) write_to_disk (spte);
-      void *pd = thread_current()->pagedir;
+    void *pd = thread_current()->pagedir;
+    /* Pinning fails if the page was evicted meanwhile, or if it is
+       still shared with a forked process. */
+    if (spte->frame != NULL
+        && (spte->type == MMAP || (spte->type == FILE && spte->writable))
+        && frame_pin_upage (pd, spte->upage))
+      write_to_disk (spte);
+    release_frame_of_page (spte);
+    if (spte->zero_mapped)
       pagedir_clear_page (pd, spte->upage);
-      free_frame (spte->frame);
-    }
+    if (spte->vma != NULL)
+      list_remove (&spte->vma_elem);
     hash_delete (&thread_current()->supp_page_table,&spte->elem);
     free (spte);
   }
 }
 
-//Helper for loading page for file type
+//Helper for loading page for file type, and the pages around it
 static bool install_load_file (struct spt_entry *spte)
 {
+  /* Read-only executable pages are shared with every other process
+     that has the same page loaded. */
+  bool loaded;
+
+  if (pagedir_is_file (thread_current ()->pagedir, spte->upage))
+    refault_cnt++;
+  loaded = (spte->type == FILE && !spte->writable
+            && frame_cache_share (spte))
+           || load_file_page (spte);
+  if (loaded)
+    file_readahead (spte);
+  return loaded;
+}
+
+/* Returns the page at UPAGE if it comes from the same file as SPTE,
+   at the matching offset, and would be read from the file if it
+   faulted.  Otherwise returns NULL. */
+static struct spt_entry *
+file_neighbour (struct spt_entry *spte, uint8_t *upage)
+{
+  struct spt_entry *n;
+  size_t slot;
+
+  if (!is_user_vaddr (upage) || upage == NULL)
+    return NULL;
+  n = uvaddr_to_spt_entry (upage);
+  if (n == NULL || n->type != spte->type || n->file != spte->file
+      || n->ofs - spte->ofs != upage - (uint8_t *) spte->upage
+      || n->frame != NULL || spte_swap_slot (n, &slot) || n->zero_mapped
+      || n->page_read_bytes == 0)
+    return NULL;
+  return n;
+}
+
+/* Called after a fault on SPTE, a FILE or MMAP page, has been
+   handled.  Maps the neighbouring read-only executable pages that
+   other processes already have in the text page cache, which costs
+   no I/O.  If the faults of the current process run through the
+   file in order, also reads ahead the pages that follow, in a
+   window that grows while the pattern holds. */
+static void file_readahead (struct spt_entry *spte)
+{
+  struct thread *t = thread_current ();
+  uint8_t *upage = spte->upage;
+  uint8_t *block;
+  int advice = spte->vma != NULL ? spte->vma->advice : MADV_NORMAL;
+  int i;
+
+  if (spte->type == FILE && !spte->writable)
+  {
+    block = (uint8_t *) ((uintptr_t) upage
+                         & ~(uintptr_t) (FAULT_AROUND_PAGES * PGSIZE - 1));
+    for (i = 0; i < FAULT_AROUND_PAGES; i++)
+    {
+      struct spt_entry *n = file_neighbour (spte, block + i * PGSIZE);
+      if (n != NULL && frame_cache_share (n))
+        fault_around_cnt++;
+    }
+  }
+
+  /* Advice overrides what the faults look like. */
+  if (advice == MADV_RANDOM)
+  {
+    t->ra_window = 0;
+    return;
+  }
+  if (advice == MADV_SEQUENTIAL)
+    t->ra_window = RA_MAX_PAGES;
+  else if (upage == t->ra_next)
+    t->ra_window = t->ra_window == 0 ? RA_MIN_PAGES
+                   : t->ra_window * 2 > RA_MAX_PAGES ? RA_MAX_PAGES
+                   : t->ra_window * 2;
+  else
+    t->ra_window = 0;
+
+  upage += PGSIZE;
+  /* Sequential regions read ahead even when memory is short, as
+     their pages are the first to be evicted anyway. */
+  for (i = 0; i < t->ra_window
+              && (advice == MADV_SEQUENTIAL || frame_plenty ());
+       i++, upage += PGSIZE)
+  {
+    struct spt_entry *n = file_neighbour (spte, upage);
+    if (n == NULL
+        || !((n->type == FILE && !n->writable && frame_cache_share (n))
+             || load_file_page (n)))
+      break;
+    readahead_cnt++;
+  }
+
+  /* A sequential reader faults next on the first page not read. */
+  t->ra_next = upage;
+}
+
+//Read one page from its file into a frame of its own
+static bool load_file_page (struct spt_entry *spte)
+{
+  bool text = spte->type == FILE && !spte->writable;
   void *frame = retrieve_frame_of_page (PAL_USER, spte);
-  ASSERT (frame != NULL);
   if (frame == NULL) return false;
 
   lock_acquire (&file_lock);
@@ -254,29 +648,402 @@ static bool install_load_file (struct spt_entry *spte)
     return false; 
   }
   spte->frame = frame;
+  if (text)
+    frame_cache_add (frame, spte);
+  frame_unpin (frame);
   return true;
 }
 
-//Free hash table entry
-static void free_spte_elem (struct hash_elem *e, void *aux)
+/* Applies ADVICE, one of the MADV_* values, to the pages of the
+   current process in [START, END), which the caller has checked
+   are all in regions.  Access pattern and large page advice is
+   kept for whole regions, so a region the range covers only part
+   of is split at the ends of the range first.  Returns false if
+   there is no memory for the split. */
+bool page_madvise (uint8_t *start, uint8_t *end, int advice)
+{
+  struct thread *t = thread_current ();
+  uint8_t *last = pg_round_up (end);
+  uint8_t *upage;
+
+  for (upage = start; upage < end; upage += PGSIZE)
+  {
+    if (advice == MADV_WILLNEED)
+    {
+      struct spt_entry *spte = uvaddr_to_spt_entry (upage);
+      if (!frame_plenty ())
+        break;
+      if (spte != NULL && prefetch_page (spte))
+        willneed_cnt++;
+    }
+    else if (advice == MADV_DONTNEED)
+      discard_page (upage);
+    else
+    {
+      struct vma *vma = vma_find (t->vma_root, upage);
+
+      lock_acquire (&file_lock);
+      if (vma->start < upage)
+        vma = vma_split (&t->vma_root, vma, upage);
+      if (vma != NULL && vma->end > last
+          && vma_split (&t->vma_root, vma, last) == NULL)
+        vma = NULL;
+      lock_release (&file_lock);
+      if (vma == NULL)
+        return false;
+
+      if (advice == MADV_HUGEPAGE || advice == MADV_NOHUGEPAGE)
+        vma->huge = advice == MADV_HUGEPAGE;
+      else
+        vma->advice = advice;
+      upage = vma->end - PGSIZE;
+    }
+  }
+  return true;
+}
+
+/* Reads SPTE's page in from its file or from swap, if it is
+   there, without mapping anything else.  Returns true if it did. */
+static bool prefetch_page (struct spt_entry *spte)
+{
+  size_t slot;
+
+  frame_wait_eviction ();
+  if (spte->frame != NULL || spte->zero_mapped)
+    return false;
+  if (spte->type == CODE)
+    return spte_swap_slot (spte, &slot) && install_load_swap (spte);
+  if (spte->page_read_bytes == 0)
+    return false;
+  return (spte->type == FILE && !spte->writable && frame_cache_share (spte))
+         || load_file_page (spte);
+}
+
+/* Throws away user page UPAGE of the current process, for
+   MADV_DONTNEED: its frame or swap slot is freed without writing
+   anything back.  The page reads as zeros when next touched, or
+   from its file if it was loaded from an executable.  File mapping
+   pages hold file data, so they are kept. */
+static void discard_page (void *upage)
+{
+  struct thread *t = thread_current ();
+  struct spt_entry *spte = spt_lookup (upage);
+  size_t slot;
+
+  if (spte != NULL)
+  {
+    if (spte->type == MMAP)
+      return;
+    release_frame_of_page (spte);
+    if (spte->zero_mapped)
+    {
+      pagedir_clear_page (t->pagedir, upage);
+      spte->zero_mapped = false;
+    }
+  }
+  if (pagedir_get_swap (t->pagedir, upage, &slot))
+  {
+    pagedir_clear_swap (t->pagedir, upage);
+    swap_free (slot, t);
+
+    /* A page fork() left in the page table only is gone. */
+    if (spte == NULL)
+      swap_unreserve (t, 1);
+  }
+  dontneed_cnt++;
+
+  /* A page of a file region is set up again from the region; a
+     stack page keeps its entry, which now loads a zeroed page. */
+  if (spte != NULL && spte->vma != NULL && spte->vma->type != CODE)
+  {
+    if (spte_anon (spte))
+      swap_unreserve (t, 1);
+    list_remove (&spte->vma_elem);
+    hash_delete (&t->supp_page_table, &spte->elem);
+    free (spte);
+  }
+}
+
+/* Copies the address space of PARENT, the process being forked,
+   into the current process.  Resident pages are shared with the
+   parent, not copied; see frame_fork_page().  Swapped out pages
+   are copied as swap entries of the page table only, and other
+   pages start out unloaded, to be set up from their region when
+   touched.  Returns false if memory runs out. */
+bool fork_spt (struct thread *parent_thread)
+{
+  struct hash_iterator i;
+  bool success = false;
+
+  /* No page of the parent may be evicted while it is copied. */
+  frame_table_lock_acquire ();
+  hash_first (&i, &parent_thread->supp_page_table);
+  while (hash_next (&i))
+  {
+    struct spt_entry *parent = hash_entry (hash_cur (&i), struct spt_entry, elem);
+    if (parent->type == MMAP
+        || (parent->frame == NULL && !parent->zero_mapped))
+      continue;
+
+    struct spt_entry *spte = create_spte ();
+    if (spte == NULL)
+      goto done;
+    spte->type = parent->type;
+    spte_details (spte, parent->upage, parent->file, parent->ofs,
+                  parent->page_zero_bytes, parent->page_read_bytes);
+    spte->writable = parent->writable;
+    if (spte_anon (spte) && !swap_reserve (thread_current (), 1))
+    {
+      free (spte);
+      goto done;
+    }
+    hash_insert (&thread_current ()->supp_page_table, &spte->elem);
+    if (parent->vma != NULL)
+    {
+      spte->vma = vma_find (thread_current ()->vma_root, spte->upage);
+      list_push_back (&spte->vma->pages, &spte->vma_elem);
+    }
+
+    if (parent->zero_mapped)
+    {
+      if (!install_page (spte->upage, zero_page, false))
+        goto done;
+      spte->zero_mapped = true;
+      zero_map_cnt++;
+    }
+    else if (!frame_fork_page (parent, spte))
+      goto done;
+  }
+  success = frame_fork_swap (parent_thread->pagedir);
+
+ done:
+  frame_table_lock_release ();
+  return success;
+}
+
+//Write back one dirty page of a file mapping
+static void write_back_mmap_elem (struct hash_elem *e, void *aux UNUSED)
 {
   struct spt_entry *spte = hash_entry (e, struct spt_entry, elem);
-  free_spte (spte);
+  uint32_t *pd = thread_current ()->pagedir;
+  if (spte->type == MMAP && spte->frame != NULL
+      && frame_pin_upage (pd, spte->upage))
+  {
+    if (write_to_disk (spte))
+      pagedir_set_dirty (pd, spte->upage, false);
+    frame_unpin_upage (pd, spte->upage);
+  }
+}
+
+/* Writes the dirty pages of the current process's file mappings
+   back to their files.  fork() calls it first, so that the child,
+   which reads its mapped pages from the files, sees what the
+   parent wrote. */
+void write_back_mmaps (void)
+{
+  hash_apply (&thread_current ()->supp_page_table, write_back_mmap_elem);
+}
+
+//Queue the page for write-back if it is a dirty page of a file mapping
+static void sync_mmap_elem (struct hash_elem *e, void *aux UNUSED)
+{
+  struct spt_entry *spte = hash_entry (e, struct spt_entry, elem);
+  if (spte->type == MMAP)
+    frame_msync_page (spte->owner->pagedir, spte->upage, true);
+}
+
+/* Frees the entries of the current process's pages that have been
+   evicted since it last did, so that a page out of memory costs
+   nothing but its page table entry: uvaddr_to_spt_entry() creates
+   the entry again from the swap entry or the region if the page is
+   touched.  Called on a page fault, when the process holds no
+   entry. */
+void page_free_cold (void)
+{
+  struct spt_entry *spte;
+
+  while ((spte = frame_pop_cold ()) != NULL)
+  {
+    if (spte->vma != NULL)
+      list_remove (&spte->vma_elem);
+    hash_delete (&thread_current ()->supp_page_table, &spte->elem);
+    free (spte);
+    cold_free_cnt++;
+  }
+}
+
+/* Writes the dirty pages of the current process's file mappings
+   back to their files, and waits until they are written, those
+   the writeback thread had already started on included.  exit()
+   calls it before the exit status can be seen, so that the parent
+   finds in the files what the process wrote. */
+void sync_mmaps (void)
+{
+  hash_apply (&thread_current ()->supp_page_table, sync_mmap_elem);
+  frame_msync_finish (true);
 }
 
-//Remove the hash entry from supp. table
-void destroy_spt (struct hash *supp_page_table)
+//Free the swap slot of a page of an exited process
+static bool reap_swap_entry (void *upage UNUSED, size_t slot, void *t)
 {
-  hash_destroy (supp_page_table, free_spte_elem);
+  swap_free (slot, t);
+  return true;
 }
 
-//If the stack doesn't exceed max_stack size, we allow the stack to grow
-bool stack_increase (void *uaddr,bool pinned,void* AUX)
+//Free the entry of a process whose frames are already released
+static void reap_spte_elem (struct hash_elem *e, void *aux UNUSED)
 {
-  void *upage = pg_round_down (uaddr);
+  struct spt_entry *spte = hash_entry (e, struct spt_entry, elem);
+  if (spte->zero_mapped)
+    pagedir_clear_page (spte->owner->pagedir, spte->upage);
+  free (spte);
+}
+
+/* Frees the pages of T, an exited process other than the current
+   one, once sync_mmaps() has written back its file mappings: its
+   frames are released in batches, and the shared zero page is
+   unmapped, so that pagedir_destroy() does not free it.  Its swap
+   slots, which its page table entries hold, are freed, and its
+   swap reservation given back.  The regions are left to
+   vma_destroy(). */
+void reap_spt (struct thread *t)
+{
+  frame_release_spt (&t->supp_page_table);
+  hash_destroy (&t->supp_page_table, reap_spte_elem);
+  pagedir_for_each_swap (t->pagedir, reap_swap_entry, t);
+  swap_unreserve (t, t->swap_reserved);
+}
+
+//Count a page in swap
+static bool count_swap_entry (void *upage UNUSED, size_t slot UNUSED,
+                              void *aux)
+{
+  (*(long long *) aux)++;
+  return true;
+}
+
+/* Fills in ST with the swap use of the current process.  A page
+   in swap has a swap entry in the page table, so they are
+   counted there. */
+void page_swap_stats (struct swap_stats *st)
+{
+  struct thread *t = thread_current ();
+
+  st->pages = 0;
+  pagedir_for_each_swap (t->pagedir, count_swap_entry, &st->pages);
+  st->reserved = t->swap_reserved;
+  st->size = 0;
+}
+
+/* Returns true if the current process can take another stack page
+   ahead of its faults: frames are plentiful and it is within its
+   resident set limit. */
+static bool stack_room (void)
+{
+  struct thread *t = thread_current ();
+  return frame_plenty () && (t->rss_limit == 0 || t->rss < t->rss_limit);
+}
+
+/* If the stack doesn't exceed max_stack size, we allow the stack to
+   grow.  The faulting address is at most a few bytes below the
+   stack pointer, so the pages between it and the stack pages
+   already mapped are stack too: a large object on the stack is
+   usually written from its low end up, and they are mapped now,
+   up to STACK_CHUNK_MAX of them.  A fault just below the lowest
+   stack page means the stack is growing down, and is likely to go
+   on: the next STACK_CHUNK pages down are mapped too. */
+bool stack_increase (void *uaddr, bool write)
+{
+  struct thread *t = thread_current ();
+  uint8_t *upage = pg_round_down (uaddr);
+  int i;
+
   if ((size_t) (PHYS_BASE - uaddr) > MAX_STACK_SIZE) return false;
   struct spt_entry *spte = create_spte_code (upage);
-  spte->pinned = pinned;
-  return install_load_page (spte);
+  if (spte == NULL)
+    return false;
+  if (!(write ? install_load_page (spte) : install_load_page_read (spte)))
+  {
+    free_stack_spte (spte);
+    return false;
+  }
+  stack_fault_cnt++;
+
+  for (i = 1; i <= STACK_CHUNK_MAX && upage + i * PGSIZE < (uint8_t *) PHYS_BASE
+              && stack_room (); i++)
+  {
+    if (!stack_map_page (upage + i * PGSIZE))
+      break;
+    stack_ahead_cnt++;
+  }
+
+  if (spt_lookup (upage + PGSIZE) == NULL)
+  {
+    t->stack_chunk = 0;
+    return true;
+  }
+  t->stack_chunk = t->stack_chunk == 0 ? STACK_CHUNK_MIN
+                   : t->stack_chunk * 2 > STACK_CHUNK_MAX ? STACK_CHUNK_MAX
+                   : t->stack_chunk * 2;
+  for (i = 1; i <= t->stack_chunk && stack_room (); i++)
+  {
+    if (!stack_map_page (upage - i * PGSIZE))
+      break;
+    stack_ahead_cnt++;
+  }
+  return true;
+}
+
+/* Maps the top CNT pages of the stack of the current process, which
+   is just being set up, at least one and at most MAX_STACK_SIZE
+   worth.  Returns false if not even the top page could be
+   mapped. */
+bool stack_populate (size_t cnt)
+{
+  uint8_t *upage = (uint8_t *) PHYS_BASE - PGSIZE;
+  size_t i;
+
+  if (cnt < 1)
+    cnt = 1;
+  if (cnt > MAX_STACK_SIZE / PGSIZE)
+    cnt = MAX_STACK_SIZE / PGSIZE;
+  for (i = 0; i < cnt; i++, upage -= PGSIZE)
+  {
+    if (!stack_map_page (upage))
+      return i > 0;
+    stack_exec_cnt++;
+  }
+  return true;
+}
+
+/* Maps a zeroed frame at stack page UPAGE of the current process,
+   unless it is beyond MAX_STACK_SIZE or already has a page, here or
+   in swap.  Returns true if it did. */
+static bool stack_map_page (void *upage)
+{
+  struct thread *t = thread_current ();
+  struct spt_entry *spte;
+  size_t slot;
+
+  if ((size_t) (PHYS_BASE - upage) > MAX_STACK_SIZE
+      || spt_lookup (upage) != NULL
+      || pagedir_get_swap (t->pagedir, upage, &slot))
+    return false;
+  spte = create_spte_code (upage);
+  if (spte == NULL)
+    return false;
+  if (!install_load_page (spte))
+  {
+    free_stack_spte (spte);
+    return false;
+  }
+  return true;
+}
+
+//Free the entry of a stack page that could not be loaded, and its swap reservation
+static void free_stack_spte (struct spt_entry *spte)
+{
+  free_spte (spte);
+  swap_unreserve (thread_current (), 1);
 }
 
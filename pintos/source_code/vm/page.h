@@ -2,6 +2,8 @@
 #define VM_PAGE
 
 #include <hash.h>
+#include <list.h>
+#include <vmstat.h>
 #include "filesys/off_t.h"
 #include "filesys/file.h"
 
@@ -18,24 +20,41 @@ struct spt_entry
     bool writable;
     uint32_t page_read_bytes;
     uint32_t page_zero_bytes;
-    bool pinned;
-    bool is_in_swap;
-    size_t idx; /* Page index in swap partition. */
+    bool zero_mapped; /* Mapped read-only to the shared zero page. */
+    struct thread *owner; /* Process whose page table holds the page. */
+    struct list_elem frame_elem; /* Element in the frame's sharers, or
+                                    in the owner's COLD_SPTES. */
+    bool cold;            /* On the owner's COLD_SPTES. */
+    struct vma *vma;      /* Region the page belongs to, if any. */
+    struct list_elem vma_elem; /* Element in the region's pages. */
   };
 
 
 //Function Declarations
+void page_init (void);
+void page_print_stats (void);
+bool is_zero_page (const void *);
 void supp_page_table_init (struct hash *);
+bool install_load_page (struct spt_entry *);
+bool install_load_page_read (struct spt_entry *);
+enum fault_class page_fault_class (struct spt_entry *);
 struct spt_entry *uvaddr_to_spt_entry (void *);
 
-bool stack_increase (void *,bool,void*);
+bool stack_increase (void *, bool);
+bool stack_populate (size_t);
 
 bool file_supp_creation (struct file *, off_t, uint8_t *,
                        uint32_t, uint32_t, bool);
-struct spt_entry* create_spte_mmap (struct file *, int, void *);
-
-void destroy_spt (struct hash *);
-void free_spte_mmap (struct spt_entry *);
+struct vma *create_vma_mmap (struct file *, int, void *);
+
+bool fork_spt (struct thread *);
+void write_back_mmaps (void);
+void page_free_cold (void);
+void sync_mmaps (void);
+void reap_spt (struct thread *);
+void page_swap_stats (struct swap_stats *);
+void free_vma_mmap (struct vma *);
+bool page_madvise (uint8_t *, uint8_t *, int);
 
 bool write_to_disk (struct spt_entry *);
 #endif
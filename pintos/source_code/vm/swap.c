@@ -1,84 +1,819 @@
 #include "threads/synch.h"
 #include "devices/disk.h"
 #include <bitmap.h>
+#include <hash.h>
+#include <inttypes.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "vm/page.h"
-#include "userprog/process.h"
+#include "vm/swap.h"
+#include "vm/zswap.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
 
-static struct disk *swap_disk = NULL;
-/* Lock acquired whenever the swap table is accessed, no lock is required while 
-   using swap partition disk functions as it internally synchronizes accesses. */
+/* Number of disk sectors in a page. */
+#define SECTORS_PER_PAGE (PGSIZE / DISK_SECTOR_SIZE)
+
+/* Swap slots are handed out in aligned clusters of this many
+   slots, and swap-in reads ahead within a cluster.  Must divide
+   MAP_BITS. */
+#define SWAP_CLUSTER 8
+
+/* Number of clusters the swap cache can hold. */
+#define SWAP_CACHE_CLUSTERS 4
+
+/* Swap devices.  Each device holds a range of slots of its own,
+   a whole number of free map words, and slot numbers run on from
+   one device to the next.  Slots come from the devices of the
+   highest priority that have free slots, so a fast disk fills up
+   before a slower one is used.  Devices of equal priority take
+   turns, one slot each, and each fills a cluster of its own, so
+   that pages swapped out one after another are written to all of
+   them at once while each cluster still holds neighbouring pages.
+   Within a priority devices are ordered by device number, then
+   channel, so that turns alternate between channels. */
+#define SWAP_DEVICE_MAX 4
+struct swap_device
+  {
+    int chan_no, dev_no;        /* Disk position. */
+    int prio;                   /* Higher is used first. */
+    struct disk *disk;
+    size_t first;               /* First slot. */
+    size_t size;                /* Number of slots. */
+    size_t next_word;           /* Where to look for a free cluster. */
+    size_t next_slot;           /* Next slot of the cluster it fills. */
+    long long cluster_cnt;      /* Clusters started on it. */
+  };
+static struct swap_device swap_devices[SWAP_DEVICE_MAX];
+static int swap_device_cnt;
+
+/* Turn of the device to take the next slot from. */
+static unsigned stripe_next;
+
+/* Lock acquired whenever the swap table is accessed, no lock is required while
+   using swap partition disk functions as it internally synchronizes accesses.
+   Swap I/O is done without holding it, and never takes file_lock, so
+   swapping does not wait for file system calls. */
 static struct lock swap_lock;
-static struct bitmap *swap_table = NULL;
 static uint32_t swap_table_size = 0;
 
-/* Initializes swap table bitmap. */
+/* Free map: bit I % MAP_BITS of word I / MAP_BITS is set while
+   slot I is in use.  It is scanned a word at a time, which passes
+   over MAP_BITS used slots at once, and a word holds
+   MAP_BITS / SWAP_CLUSTER whole clusters.  The bits past the last
+   slot are set, so they are never handed out. */
+#define MAP_BITS 32
+static uint32_t *swap_map = NULL;
+static size_t swap_map_words;
+static size_t swap_used;
+
+/* Slots allocated by swap_alloc() whose page swap_write() has not
+   written yet, in the same layout as SWAP_MAP.  The page table
+   entries of the page already refer to a pending slot; swap_in()
+   waits on SWAP_WRITTEN until it has been written. */
+static uint32_t *swap_pending = NULL;
+static struct condition swap_written;
+
+/* Pages swap space is reserved for.  Every page that may have to
+   go to swap, an anonymous page, is counted when it is created,
+   and creating it fails if there would be more of them than swap
+   slots and user frames together; so it is the page's creation
+   that fails, not a later swap out.  See swap_reserve(). */
+static size_t swap_reserved;
+
+/* With -overcommit, creating a page never fails for want of swap:
+   the pages are counted all the same, but when swap fills up the
+   OOM killer makes room.  See oom_kill(). */
+bool swap_overcommit;
+
+/* The swap table keeps about a byte and a half for each slot,
+   besides the free and pending maps, so that large swap disks fit
+   in the kernel pool. */
+
+/* Thread that swapped out the pages in each cluster, for
+   readahead, or TID_ERROR if they come from several threads.  Set
+   when a cluster gets its first slot. */
+static tid_t *cluster_owner = NULL;
+
+/* Number of references to each slot: one from each page table
+   entry, and one from the write of a pending slot.  A page shared
+   after fork() is swapped out once, and its slot is freed when the
+   last process has read it back or dropped it and the write is
+   done.  Counts of SWAP_REF_OVERFLOW and more, for a page shared
+   by that many processes, are kept in SWAP_REF_TABLE instead. */
+#define SWAP_REF_OVERFLOW UINT8_MAX
+static uint8_t *swap_ref_cnt = NULL;
+static struct hash swap_ref_table;
+
+/* Reference count of a slot with SWAP_REF_OVERFLOW or more. */
+struct swap_ref_overflow
+  {
+    struct hash_elem elem;      /* Element in swap_ref_table. */
+    size_t slot;
+    unsigned cnt;
+  };
+
+/* Swap cache: pages read ahead from one swap cluster.  Bit I of
+   VALID is set if PAGES holds the current contents of slot
+   CLUSTER * SWAP_CLUSTER + I.  While FILLING, the read is still in
+   progress and VALID holds the slots it will make valid; freeing
+   a slot clears its bit, so a slot freed and reused during the
+   read is not cached with stale contents. */
+struct swap_cache_entry
+  {
+    size_t cluster;             /* Cached cluster, or SIZE_MAX. */
+    uint32_t valid;             /* Valid slots in the cluster. */
+    bool filling;               /* Read in progress. */
+    uint8_t *pages;             /* SWAP_CLUSTER pages of data. */
+  };
+static struct swap_cache_entry swap_cache[SWAP_CACHE_CLUSTERS];
+static int swap_cache_next;     /* Next entry to replace. */
+
+/* Statistics. */
+static long long swap_out_cnt;
+static long long swap_in_cnt;
+static long long swap_cache_hit_cnt;
+static long long swap_readahead_cnt;
+static long long swap_deny_cnt;
+
+static bool add_device (int chan_no, int dev_no, int prio);
+static struct swap_device *slot_device (size_t idx);
+static size_t alloc_slot (void);
+static void free_slot (size_t idx);
+static bool slot_used (size_t idx);
+static bool slot_pending (size_t idx);
+static void slot_ref (size_t idx);
+static bool slot_unref (size_t idx);
+static hash_hash_func ref_overflow_hash;
+static hash_less_func ref_overflow_less;
+static void cluster_set_owner (size_t idx, tid_t tid);
+static bool swap_cache_lookup (size_t idx, void *page);
+static void swap_read_cluster (size_t idx, void *page);
+
+/* Sets the swap devices from LIST, given with -swap.  LIST is a
+   comma-separated list of CHAN:DEV[:PRIO], one for each disk to
+   swap to.  Without -swap, hd1:1 is the swap disk. */
+void
+swap_configure (char *list)
+{
+  char *item, *save_ptr;
+
+  if (list == NULL)
+    PANIC ("missing swap devices (use -h for help)");
+  swap_device_cnt = 0;
+  for (item = strtok_r (list, ",", &save_ptr); item != NULL;
+       item = strtok_r (NULL, ",", &save_ptr))
+  {
+    char *chan, *dev, *prio, *p;
+
+    chan = strtok_r (item, ":", &p);
+    dev = strtok_r (NULL, ":", &p);
+    prio = strtok_r (NULL, ":", &p);
+    if (chan == NULL || dev == NULL
+        || !add_device (atoi (chan), atoi (dev),
+                        prio != NULL ? atoi (prio) : 0))
+      PANIC ("bad swap device `%s' (use -h for help)", item);
+  }
+}
+
+/* Adds disk DEV_NO on channel CHAN_NO as a swap device of
+   priority PRIO, keeping the devices in the order they are
+   striped over.  Returns false if the disk cannot be one: hd0:0
+   holds the kernel and hd0:1 the file system. */
+static bool
+add_device (int chan_no, int dev_no, int prio)
+{
+  struct swap_device *d;
+  int i;
+
+  if (chan_no < 0 || dev_no < 0 || dev_no > 1 || chan_no == 0
+      || swap_device_cnt == SWAP_DEVICE_MAX)
+    return false;
+  for (i = 0; i < swap_device_cnt; i++)
+    if (swap_devices[i].chan_no == chan_no
+        && swap_devices[i].dev_no == dev_no)
+      return false;
+
+  for (i = swap_device_cnt; i > 0; i--)
+  {
+    struct swap_device *prev = &swap_devices[i - 1];
+    if (prev->prio > prio
+        || (prev->prio == prio
+            && (prev->dev_no < dev_no
+                || (prev->dev_no == dev_no && prev->chan_no < chan_no))))
+      break;
+    swap_devices[i] = *prev;
+  }
+  d = &swap_devices[i];
+  d->chan_no = chan_no;
+  d->dev_no = dev_no;
+  d->prio = prio;
+  swap_device_cnt++;
+  return true;
+}
+
+/* Initializes the swap devices, the swap table and its free
+   map. */
 void
-swap_init()
+swap_init (void)
 {
-  swap_disk = disk_get (1,1);
+  int i, j;
+
+  if (swap_device_cnt == 0)
+    add_device (1, 1, 0);
+
+  /* Lay out the slots of the devices that are there. */
+  for (i = j = 0; i < swap_device_cnt; i++)
+  {
+    struct swap_device *d = &swap_devices[i];
+
+    d->disk = disk_get (d->chan_no, d->dev_no);
+    if (d->disk == NULL)
+      continue;
+    d->size = disk_size (d->disk) / SECTORS_PER_PAGE / MAP_BITS * MAP_BITS;
+    if (d->size == 0)
+      continue;
+    d->first = swap_table_size;
+    d->next_word = 0;
+    d->next_slot = d->first;
+    d->cluster_cnt = 0;
+    swap_table_size += d->size;
+    swap_devices[j++] = *d;
+  }
+  swap_device_cnt = j;
+
   lock_init (&swap_lock);
-  if (swap_disk != NULL){
-    swap_table_size = disk_size (swap_disk) / SECTORS_PER_PAGE;
-    swap_table = bitmap_create (swap_table_size);
+  cond_init (&swap_written);
+  if (swap_table_size > 0){
+    swap_map_words = swap_table_size / MAP_BITS;
+    swap_map = calloc (swap_map_words, sizeof *swap_map);
+    swap_pending = calloc (swap_map_words, sizeof *swap_pending);
+    cluster_owner = malloc (swap_table_size / SWAP_CLUSTER
+                            * sizeof *cluster_owner);
+    swap_ref_cnt = malloc (swap_table_size * sizeof *swap_ref_cnt);
+    if (swap_map == NULL || swap_pending == NULL || cluster_owner == NULL
+        || swap_ref_cnt == NULL
+        || !hash_init (&swap_ref_table, ref_overflow_hash, ref_overflow_less,
+                       NULL))
+      PANIC ("Not able to allocate swap table");
+    zswap_init (swap_table_size);
+  }
+  stripe_next = 0;
+
+  for (i = 0; i < SWAP_CACHE_CLUSTERS; i++)
+  {
+    swap_cache[i].cluster = SIZE_MAX;
+    swap_cache[i].valid = 0;
+    swap_cache[i].filling = false;
+    swap_cache[i].pages = palloc_get_multiple (PAL_ASSERT, SWAP_CLUSTER);
   }
+  swap_cache_next = 0;
 }
 
-/* Fetches an empty slot, for the given read-only memory frame, 
-   it puts it into swap partition and returns index which can help
-   swap_in the frame. */
+/* Allocates a swap slot for a page of OWNER that is being swapped
+   out, and returns it, or BITMAP_ERROR if swap is full.  The slot
+   holds a reference for a page table entry of OWNER, which the
+   caller points to it, and one for the write of the page, which
+   the caller makes with swap_write().  Until then the slot is
+   pending. */
 size_t
-swap_out (struct spt_entry *spte)
+swap_alloc (struct thread *owner)
 {
-  if (swap_table != NULL)
+  size_t idx = BITMAP_ERROR;
+
+  if (swap_map != NULL)
   {
     lock_acquire (&swap_lock);
-    size_t idx = bitmap_scan_and_flip (swap_table, 0, 1, false);
+    idx = alloc_slot ();
     if (idx != BITMAP_ERROR)
     {
-      int i;
-      for (i = 0; i<SECTORS_PER_PAGE; i++)
-      {
-        lock_acquire (&file_lock);
-        disk_write (swap_disk, (idx * SECTORS_PER_PAGE) + i,
-                    spte->frame + (i * DISK_SECTOR_SIZE));
-        lock_release (&file_lock);
-      }
+      slot_ref (idx);
+      swap_pending[idx / MAP_BITS] |= 1u << idx % MAP_BITS;
+      cluster_set_owner (idx, owner->tid);
+      owner->swap_cnt++;
+      swap_out_cnt++;
     }
     lock_release (&swap_lock);
-    return idx;
   }
-  return BITMAP_ERROR;
+  return idx;
+}
+
+/* Writes PAGE to pending slot IDX, from swap_alloc(), and drops the
+   reference the write held.  The page is kept compressed in memory
+   if it compresses well; otherwise it is written to the disk in one
+   request.  Called without any lock held, so that faults and other
+   swap outs go on meanwhile. */
+void
+swap_write (size_t idx, const void *page)
+{
+  if (!zswap_store (idx, page))
+    swap_write_slot (idx, page);
+
+  lock_acquire (&swap_lock);
+  ASSERT (slot_pending (idx));
+  swap_pending[idx / MAP_BITS] &= ~(1u << idx % MAP_BITS);
+  cond_broadcast (&swap_written, &swap_lock);
+  if (slot_unref (idx))
+    free_slot (idx);
+  lock_release (&swap_lock);
 }
 
-/* Gets a frame from allocator for the spte and loads the page from 
-   SWAP partition to memory. */
+/* Loads the page in swap slot IDX into the frame of SPTE, and
+   drops the reference to the slot the page held.  If the page is
+   still being written to the slot, waits for the write first.
+   Neighbouring slots of the current process are read ahead into
+   the swap cache. */
 void
-swap_in (struct spt_entry *spte)
+swap_in (struct spt_entry *spte, size_t idx)
 {
-  if (swap_table != NULL)
+  if (swap_map != NULL)
   {
     lock_acquire (&swap_lock);
-    size_t idx = spte->idx;
-    int i;
-    for (i = 0; i<SECTORS_PER_PAGE; i++)
-    {
-      lock_acquire (&file_lock);
-      disk_read (swap_disk, (idx * SECTORS_PER_PAGE) + i,
-                 spte->frame + (i * DISK_SECTOR_SIZE));
-      lock_release (&file_lock);
-    }
-    bitmap_reset (swap_table, idx);
+    while (slot_pending (idx))
+      cond_wait (&swap_written, &swap_lock);
     lock_release (&swap_lock);
+
+    if (!zswap_load (idx, spte->frame)
+        && !swap_cache_lookup (idx, spte->frame))
+      swap_read_cluster (idx, spte->frame);
+
+    lock_acquire (&swap_lock);
+    if (slot_unref (idx))
+      free_slot (idx);
+    spte->owner->swap_cnt--;
+    swap_in_cnt++;
+    lock_release (&swap_lock);
+  }
+}
+
+/* Adds a reference to swap slot IDX from a page table entry of
+   process T, for a page shared by several processes when it is
+   swapped out, or one that fork() copies while it is swapped
+   out. */
+void
+swap_dup (size_t idx, struct thread *t)
+{
+  lock_acquire (&swap_lock);
+  ASSERT (slot_used (idx));
+  slot_ref (idx);
+  t->swap_cnt++;
+  lock_release (&swap_lock);
+}
+
+/* Drops the reference to swap slot IDX of process T, for a page
+   thrown away while swapped out, and frees the slot with the last
+   one. */
+void
+swap_free (size_t idx, struct thread *t)
+{
+  lock_acquire (&swap_lock);
+  ASSERT (slot_used (idx));
+  if (slot_unref (idx))
+    free_slot (idx);
+  t->swap_cnt--;
+  lock_release (&swap_lock);
+}
+
+/* Writes PAGE to swap slot IDX.  Writes to different channels
+   proceed at the same time. */
+void
+swap_write_slot (size_t idx, const void *page)
+{
+  struct swap_device *d = slot_device (idx);
+
+  disk_write_multiple (d->disk, (idx - d->first) * SECTORS_PER_PAGE,
+                       SECTORS_PER_PAGE, page);
+}
+
+/* Reserves swap space for CNT more anonymous pages of process T.
+   Returns false, reserving nothing, if there would be more such
+   pages than swap slots and user frames to hold them.  A page
+   shared after fork() is reserved for by each process, since each
+   may come to have a copy of its own. */
+bool
+swap_reserve (struct thread *t, size_t cnt)
+{
+  bool ok;
+
+  lock_acquire (&swap_lock);
+  ok = swap_overcommit
+       || swap_reserved + cnt <= swap_table_size + palloc_user_page_cnt ();
+  if (ok)
+  {
+    swap_reserved += cnt;
+    t->swap_reserved += cnt;
   }
+  else
+    swap_deny_cnt++;
+  lock_release (&swap_lock);
+  return ok;
 }
 
+/* Gives back the reservation of CNT anonymous pages of T. */
 void
-swap_end ()
+swap_unreserve (struct thread *t, size_t cnt)
 {
-  if (swap_table != NULL)
+  lock_acquire (&swap_lock);
+  ASSERT (swap_reserved >= cnt && t->swap_reserved >= cnt);
+  swap_reserved -= cnt;
+  t->swap_reserved -= cnt;
+  lock_release (&swap_lock);
+}
+
+/* Returns true if no swap slot is free, so that no page can be
+   swapped out.  Called with the frame table lock held.  Slots are
+   only allocated by evict_frame(), under that lock, so a false
+   answer holds until the caller swaps a page out; the count is
+   read without swap_lock. */
+bool
+swap_full (void)
+{
+  return swap_used == swap_table_size;
+}
+
+/* Returns the number of swap devices in use. */
+int
+swap_device_count (void)
+{
+  return swap_device_cnt;
+}
+
+/* Fills in ST with the system-wide use of swap. */
+void
+swap_get_stats (struct swap_stats *st)
+{
+  lock_acquire (&swap_lock);
+  st->pages = swap_used;
+  st->reserved = swap_reserved;
+  st->size = swap_table_size;
+  lock_release (&swap_lock);
+}
+
+void
+swap_end (void)
+{
+  if (swap_map != NULL)
   {
     lock_acquire (&swap_lock);
-    bitmap_destroy (swap_table);
+    free (swap_map);
+    swap_map = NULL;
     lock_release (&swap_lock);
   }
 }
+
+/* Prints swap statistics. */
+void
+swap_print_stats (void)
+{
+  int i;
+
+  printf ("Swap: %lld pages out, %lld pages in, %lld swap cache hits, "
+          "%lld pages read ahead\n",
+          swap_out_cnt, swap_in_cnt, swap_cache_hit_cnt, swap_readahead_cnt);
+  printf ("Swap: %zu of %"PRIu32" slots in use, %zu pages reserved, "
+          "%lld reservations denied\n",
+          swap_used, swap_table_size, swap_reserved, swap_deny_cnt);
+  for (i = 0; i < swap_device_cnt; i++)
+  {
+    struct swap_device *d = &swap_devices[i];
+    printf ("Swap: hd%d:%d, priority %d, %zu slots, %lld clusters\n",
+            d->chan_no, d->dev_no, d->prio, d->size, d->cluster_cnt);
+  }
+  zswap_print_stats ();
+}
+
+/* Returns the device that holds slot IDX. */
+static struct swap_device *
+slot_device (size_t idx)
+{
+  int i;
+
+  for (i = 0; i < swap_device_cnt; i++)
+    if (idx < swap_devices[i].first + swap_devices[i].size)
+      return &swap_devices[i];
+  NOT_REACHED ();
+}
+
+/* Returns true if slot IDX is in use.  Called with swap_lock
+   held. */
+static bool
+slot_used (size_t idx)
+{
+  return (swap_map[idx / MAP_BITS] & (1u << idx % MAP_BITS)) != 0;
+}
+
+/* Returns true if slot IDX is waiting for its page to be written.
+   Called with swap_lock held. */
+static bool
+slot_pending (size_t idx)
+{
+  return (swap_pending[idx / MAP_BITS] & (1u << idx % MAP_BITS)) != 0;
+}
+
+/* Adds a reference to slot IDX.  Called with swap_lock held. */
+static void
+slot_ref (size_t idx)
+{
+  struct swap_ref_overflow *o, key;
+
+  if (swap_ref_cnt[idx] < SWAP_REF_OVERFLOW - 1)
+    swap_ref_cnt[idx]++;
+  else if (swap_ref_cnt[idx] == SWAP_REF_OVERFLOW - 1)
+  {
+    o = malloc (sizeof *o);
+    if (o == NULL)
+      PANIC ("Not able to allocate swap reference count");
+    o->slot = idx;
+    o->cnt = SWAP_REF_OVERFLOW;
+    hash_insert (&swap_ref_table, &o->elem);
+    swap_ref_cnt[idx] = SWAP_REF_OVERFLOW;
+  }
+  else
+  {
+    key.slot = idx;
+    o = hash_entry (hash_find (&swap_ref_table, &key.elem),
+                    struct swap_ref_overflow, elem);
+    o->cnt++;
+  }
+}
+
+/* Drops a reference to slot IDX.  Returns true if it was the last
+   one.  Called with swap_lock held. */
+static bool
+slot_unref (size_t idx)
+{
+  struct swap_ref_overflow *o, key;
+
+  ASSERT (swap_ref_cnt[idx] > 0);
+  if (swap_ref_cnt[idx] < SWAP_REF_OVERFLOW)
+    return --swap_ref_cnt[idx] == 0;
+
+  key.slot = idx;
+  o = hash_entry (hash_find (&swap_ref_table, &key.elem),
+                  struct swap_ref_overflow, elem);
+  if (--o->cnt < SWAP_REF_OVERFLOW)
+  {
+    swap_ref_cnt[idx] = o->cnt;
+    hash_delete (&swap_ref_table, &o->elem);
+    free (o);
+  }
+  return false;
+}
+
+/* Returns the hash of the slot of overflow count E. */
+static unsigned
+ref_overflow_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_int (hash_entry (e, struct swap_ref_overflow, elem)->slot);
+}
+
+/* Orders overflow counts by slot. */
+static bool
+ref_overflow_less (const struct hash_elem *a, const struct hash_elem *b,
+                   void *aux UNUSED)
+{
+  return hash_entry (a, struct swap_ref_overflow, elem)->slot
+         < hash_entry (b, struct swap_ref_overflow, elem)->slot;
+}
+
+/* Records TID as having swapped out the page in the newly
+   allocated slot IDX.  Called with swap_lock held. */
+static void
+cluster_set_owner (size_t idx, tid_t tid)
+{
+  size_t cluster = idx / SWAP_CLUSTER;
+  size_t first = cluster * SWAP_CLUSTER;
+  uint32_t used = (swap_map[first / MAP_BITS] >> first % MAP_BITS)
+                  & ((1u << SWAP_CLUSTER) - 1);
+
+  if (used == 1u << (idx - first))
+    cluster_owner[cluster] = tid;
+  else if (cluster_owner[cluster] != tid)
+    cluster_owner[cluster] = TID_ERROR;
+}
+
+/* Returns the first slot of a free cluster on device D, looking
+   on from where the last one was found and wrapping around, or
+   BITMAP_ERROR if there is none.  Called with swap_lock held. */
+static size_t
+find_free_cluster (struct swap_device *d)
+{
+  size_t words = d->size / MAP_BITS;
+  size_t i;
+
+  for (i = 0; i < words; i++)
+  {
+    size_t word = d->first / MAP_BITS + (d->next_word + i) % words;
+    uint32_t bits = swap_map[word];
+    size_t c;
+
+    if (bits == UINT32_MAX)
+      continue;
+    for (c = 0; c < MAP_BITS; c += SWAP_CLUSTER)
+      if (((bits >> c) & ((1u << SWAP_CLUSTER) - 1)) == 0)
+      {
+        d->next_word = (d->next_word + i) % words;
+        d->cluster_cnt++;
+        return word * MAP_BITS + c;
+      }
+  }
+  return BITMAP_ERROR;
+}
+
+/* Returns the next slot of the cluster device D is filling,
+   starting a new cluster if that one is full, or BITMAP_ERROR if
+   D has no free cluster.  Called with swap_lock held. */
+static size_t
+device_next_slot (struct swap_device *d)
+{
+  if (d->next_slot % SWAP_CLUSTER == 0 || slot_used (d->next_slot))
+  {
+    size_t idx = find_free_cluster (d);
+    if (idx == BITMAP_ERROR)
+      return BITMAP_ERROR;
+    d->next_slot = idx;
+  }
+  return d->next_slot++;
+}
+
+/* Returns a free slot from the devices of the highest priority
+   that have a free cluster, in turn, or BITMAP_ERROR if there is
+   none.  Called with swap_lock held. */
+static size_t
+stripe_next_slot (void)
+{
+  int lo, hi, i;
+
+  for (lo = 0; lo < swap_device_cnt; lo = hi)
+  {
+    int n;
+
+    for (hi = lo + 1; hi < swap_device_cnt
+                      && swap_devices[hi].prio == swap_devices[lo].prio; hi++)
+      continue;
+    n = hi - lo;
+    for (i = 0; i < n; i++)
+    {
+      struct swap_device *d = &swap_devices[lo + (stripe_next + i) % n];
+      size_t idx = device_next_slot (d);
+      if (idx != BITMAP_ERROR)
+      {
+        stripe_next += i + 1;
+        return idx;
+      }
+    }
+  }
+  return BITMAP_ERROR;
+}
+
+/* Returns the lowest free slot, or BITMAP_ERROR if there is none.
+   Called with swap_lock held. */
+static size_t
+find_free_slot (void)
+{
+  size_t word;
+
+  for (word = 0; word < swap_map_words; word++)
+    if (swap_map[word] != UINT32_MAX)
+      return word * MAP_BITS + __builtin_ctz (~swap_map[word]);
+  return BITMAP_ERROR;
+}
+
+/* Allocates a swap slot.  Each device takes its slots in order
+   from a free, aligned cluster, so that pages swapped out one
+   after another, as an eviction sweep does, end up next to each
+   other on its disk.  Called with swap_lock held. */
+static size_t
+alloc_slot (void)
+{
+  size_t idx;
+
+  ASSERT (lock_held_by_current_thread (&swap_lock));
+
+  /* No free cluster left: any free slot will do. */
+  idx = stripe_next_slot ();
+  if (idx == BITMAP_ERROR)
+    idx = find_free_slot ();
+  if (idx == BITMAP_ERROR)
+    return BITMAP_ERROR;
+
+  swap_map[idx / MAP_BITS] |= 1u << idx % MAP_BITS;
+  swap_used++;
+  swap_ref_cnt[idx] = 1;
+  return idx;
+}
+
+/* Frees swap slot IDX and drops it from the swap cache.
+   Called with swap_lock held. */
+static void
+free_slot (size_t idx)
+{
+  int i;
+
+  ASSERT (lock_held_by_current_thread (&swap_lock));
+
+  swap_map[idx / MAP_BITS] &= ~(1u << idx % MAP_BITS);
+  swap_used--;
+  zswap_invalidate (idx);
+  for (i = 0; i < SWAP_CACHE_CLUSTERS; i++)
+    if (swap_cache[i].cluster == idx / SWAP_CLUSTER)
+      swap_cache[i].valid &= ~(1u << (idx % SWAP_CLUSTER));
+}
+
+/* Copies slot IDX from the swap cache into PAGE.  Returns false
+   if the slot is not cached. */
+static bool
+swap_cache_lookup (size_t idx, void *page)
+{
+  bool hit = false;
+  int i;
+
+  lock_acquire (&swap_lock);
+  for (i = 0; i < SWAP_CACHE_CLUSTERS; i++)
+  {
+    struct swap_cache_entry *e = &swap_cache[i];
+    if (e->cluster == idx / SWAP_CLUSTER && !e->filling
+        && (e->valid & (1u << (idx % SWAP_CLUSTER))))
+    {
+      memcpy (page, e->pages + idx % SWAP_CLUSTER * PGSIZE, PGSIZE);
+      hit = true;
+      swap_cache_hit_cnt++;
+      break;
+    }
+  }
+  lock_release (&swap_lock);
+  return hit;
+}
+
+/* Reads slot IDX into PAGE, together with the slots around it in
+   its cluster if the current process swapped out the whole
+   cluster, in a single disk request.  The neighbours go into the
+   swap cache.  Slots whose
+   page is in the compressed cache, or not written yet, are not on
+   the disk, so they are not read ahead. */
+static void
+swap_read_cluster (size_t idx, void *page)
+{
+  size_t cluster = idx / SWAP_CLUSTER;
+  size_t first = cluster * SWAP_CLUSTER;
+  size_t lo = idx, hi = idx, i;
+  tid_t tid = thread_current ()->tid;
+  struct swap_cache_entry *e = NULL;
+  struct swap_device *d;
+  uint32_t valid = 0;
+
+  lock_acquire (&swap_lock);
+  if (cluster_owner[cluster] == tid)
+    for (i = first; i < first + SWAP_CLUSTER; i++)
+      if (i != idx && slot_used (i) && !slot_pending (i)
+          && !zswap_contains (i))
+      {
+        if (i < lo)
+          lo = i;
+        if (i > hi)
+          hi = i;
+        valid |= 1u << (i - first);
+      }
+
+  /* Take over a cache entry unless a read is in progress in it. */
+  if (valid != 0)
+    for (i = 0; i < SWAP_CACHE_CLUSTERS && e == NULL; i++)
+    {
+      struct swap_cache_entry *c = &swap_cache[swap_cache_next];
+      swap_cache_next = (swap_cache_next + 1) % SWAP_CACHE_CLUSTERS;
+      if (!c->filling)
+      {
+        e = c;
+        e->cluster = cluster;
+        e->valid = valid;
+        e->filling = true;
+      }
+    }
+  lock_release (&swap_lock);
+
+  /* A cluster never spans two devices. */
+  d = slot_device (idx);
+  if (e == NULL)
+  {
+    disk_read_multiple (d->disk, (idx - d->first) * SECTORS_PER_PAGE,
+                        SECTORS_PER_PAGE, page);
+    return;
+  }
+
+  disk_read_multiple (d->disk, (lo - d->first) * SECTORS_PER_PAGE,
+                      (hi - lo + 1) * SECTORS_PER_PAGE,
+                      e->pages + (lo - first) * PGSIZE);
+  memcpy (page, e->pages + (idx - first) * PGSIZE, PGSIZE);
+
+  lock_acquire (&swap_lock);
+  e->filling = false;
+  for (i = 0; i < SWAP_CLUSTER; i++)
+    if (e->valid & (1u << i))
+      swap_readahead_cnt++;
+  lock_release (&swap_lock);
+}
@@ -1,9 +1,28 @@
 #ifndef VM_SWAP
 #define VM_SWAP
 
-void swap_init();
-size_t swap_out (struct spt_entry *);
-void swap_in (struct spt_entry *);
-void swap_end ();
+#include <stdbool.h>
+#include <stddef.h>
+#include <vmstat.h>
+#include "vm/page.h"
+#include "threads/thread.h"
+
+extern bool swap_overcommit;
+
+void swap_configure (char *);
+void swap_init (void);
+size_t swap_alloc (struct thread *);
+void swap_write (size_t, const void *);
+void swap_in (struct spt_entry *, size_t);
+void swap_dup (size_t, struct thread *);
+void swap_free (size_t, struct thread *);
+void swap_write_slot (size_t, const void *);
+bool swap_reserve (struct thread *, size_t);
+void swap_unreserve (struct thread *, size_t);
+bool swap_full (void);
+int swap_device_count (void);
+void swap_get_stats (struct swap_stats *);
+void swap_end (void);
+void swap_print_stats (void);
 
 #endif
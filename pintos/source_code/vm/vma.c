@@ -0,0 +1,289 @@
+#include "vm/vma.h"
+#include <debug.h>
+#include <mman.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/vaddr.h"
+
+static struct vma *tree_insert (struct vma *, struct vma *);
+static struct vma *tree_remove (struct vma *, struct vma *);
+
+/* Creates region [START, END) with the given attributes and adds
+   it to the tree at *ROOT.  Returns the region, or a null pointer
+   if it overlaps one already in the tree or memory runs out. */
+struct vma *
+vma_create (struct vma **root, void *start, void *end, enum spte_type type,
+            struct file *file, off_t ofs, uint32_t read_bytes, bool writable)
+{
+  struct vma *vma;
+
+  ASSERT (pg_ofs (start) == 0 && pg_ofs (end) == 0);
+  ASSERT (start < end);
+
+  if (vma_overlaps (*root, start, end))
+    return NULL;
+  vma = malloc (sizeof *vma);
+  if (vma == NULL)
+    return NULL;
+
+  vma->start = start;
+  vma->end = end;
+  vma->type = type;
+  vma->file = file;
+  vma->ofs = ofs;
+  vma->read_bytes = read_bytes;
+  vma->writable = writable;
+  vma->advice = MADV_NORMAL;
+  vma->huge = false;
+  list_init (&vma->pages);
+  vma->left = vma->right = NULL;
+  vma->height = 1;
+  *root = tree_insert (*root, vma);
+  return vma;
+}
+
+/* Returns the region in the tree at ROOT that contains ADDR, or a
+   null pointer if there is none. */
+struct vma *
+vma_find (struct vma *root, const void *addr)
+{
+  const uint8_t *a = addr;
+
+  while (root != NULL)
+    if (a < root->start)
+      root = root->left;
+    else if (a >= root->end)
+      root = root->right;
+    else
+      return root;
+  return NULL;
+}
+
+/* Returns true if any region in the tree at ROOT overlaps
+   [START, END). */
+bool
+vma_overlaps (struct vma *root, const void *start, const void *end)
+{
+  const uint8_t *s = start, *e = end;
+
+  while (root != NULL)
+    if (e <= root->start)
+      root = root->left;
+    else if (s >= root->end)
+      root = root->right;
+    else
+      return true;
+  return false;
+}
+
+/* Removes VMA from the tree at *ROOT and frees it.  Its pages must
+   already have been freed. */
+void
+vma_remove (struct vma **root, struct vma *vma)
+{
+  ASSERT (list_empty (&vma->pages));
+  *root = tree_remove (*root, vma);
+  free (vma);
+}
+
+/* Splits VMA at ADDR, a page boundary strictly inside it, so that
+   advice can be given for part of it.  VMA keeps [START, ADDR); a
+   new region with the same attributes gets [ADDR, END), and the
+   pages in it.  A new MMAP region holds a reference of its own to
+   the mapped file.  Returns the new region, or a null pointer if
+   memory runs out.  Called with file_lock held. */
+struct vma *
+vma_split (struct vma **root, struct vma *vma, void *addr)
+{
+  uint8_t *a = addr;
+  uint32_t head = a - vma->start;
+  struct vma *tail;
+  struct list_elem *e;
+
+  ASSERT (pg_ofs (addr) == 0);
+  ASSERT (vma->start < a && a < vma->end);
+
+  tail = malloc (sizeof *tail);
+  if (tail == NULL)
+    return NULL;
+  *tail = *vma;
+  tail->start = a;
+  tail->ofs = vma->ofs + head;
+  tail->read_bytes = vma->read_bytes > head ? vma->read_bytes - head : 0;
+  if (tail->type == MMAP)
+    file_dup (tail->file);
+  list_init (&tail->pages);
+  tail->left = tail->right = NULL;
+  tail->height = 1;
+
+  vma->end = a;
+  if (vma->read_bytes > head)
+    vma->read_bytes = head;
+  for (e = list_begin (&vma->pages); e != list_end (&vma->pages); )
+  {
+    struct spt_entry *spte = list_entry (e, struct spt_entry, vma_elem);
+    e = list_next (e);
+    if ((uint8_t *) spte->upage >= a)
+    {
+      list_remove (&spte->vma_elem);
+      list_push_back (&tail->pages, &spte->vma_elem);
+      spte->vma = tail;
+    }
+  }
+  *root = tree_insert (*root, tail);
+  return tail;
+}
+
+/* Copies the tree at PARENT into *CHILD, for fork().  The copies
+   have no pages yet; a copied MMAP region holds a reference of its
+   own to the mapped file.  Returns false if memory runs out,
+   leaving in *CHILD what was copied so far.  Called with file_lock
+   held. */
+bool
+vma_fork (struct vma *parent, struct vma **child)
+{
+  struct vma *vma;
+
+  *child = NULL;
+  if (parent == NULL)
+    return true;
+  vma = malloc (sizeof *vma);
+  if (vma == NULL)
+    return false;
+  *vma = *parent;
+  if (vma->type == MMAP)
+    file_dup (vma->file);
+  list_init (&vma->pages);
+  vma->left = vma->right = NULL;
+  *child = vma;
+  return vma_fork (parent->left, &vma->left)
+         && vma_fork (parent->right, &vma->right);
+}
+
+/* Frees every region in the tree at *ROOT, which becomes empty,
+   and closes the files of MMAP regions.  Their pages must already
+   have been freed.  Called with file_lock held. */
+void
+vma_destroy (struct vma **root)
+{
+  struct vma *vma = *root;
+
+  if (vma != NULL)
+    {
+      vma_destroy (&vma->left);
+      vma_destroy (&vma->right);
+      if (vma->type == MMAP)
+        file_close (vma->file);
+      free (vma);
+      *root = NULL;
+    }
+}
+
+/* AVL tree balancing. */
+
+static int
+height (struct vma *t)
+{
+  return t != NULL ? t->height : 0;
+}
+
+static void
+update (struct vma *t)
+{
+  int l = height (t->left), r = height (t->right);
+  t->height = (l > r ? l : r) + 1;
+}
+
+static struct vma *
+rotate_right (struct vma *t)
+{
+  struct vma *l = t->left;
+  t->left = l->right;
+  l->right = t;
+  update (t);
+  update (l);
+  return l;
+}
+
+static struct vma *
+rotate_left (struct vma *t)
+{
+  struct vma *r = t->right;
+  t->right = r->left;
+  r->left = t;
+  update (t);
+  update (r);
+  return r;
+}
+
+/* Restores the AVL property at T, whose subtrees are balanced and
+   differ in height by at most 2.  Returns the new subtree root. */
+static struct vma *
+balance (struct vma *t)
+{
+  int diff = height (t->left) - height (t->right);
+
+  update (t);
+  if (diff > 1)
+    {
+      if (height (t->left->left) < height (t->left->right))
+        t->left = rotate_left (t->left);
+      return rotate_right (t);
+    }
+  if (diff < -1)
+    {
+      if (height (t->right->right) < height (t->right->left))
+        t->right = rotate_right (t->right);
+      return rotate_left (t);
+    }
+  return t;
+}
+
+/* Inserts VMA into the subtree at T.  Returns the new root. */
+static struct vma *
+tree_insert (struct vma *t, struct vma *vma)
+{
+  if (t == NULL)
+    return vma;
+  if (vma->start < t->start)
+    t->left = tree_insert (t->left, vma);
+  else
+    t->right = tree_insert (t->right, vma);
+  return balance (t);
+}
+
+/* Removes the leftmost node from the subtree at T, storing it in
+   *MIN.  Returns the new root. */
+static struct vma *
+tree_remove_min (struct vma *t, struct vma **min)
+{
+  if (t->left == NULL)
+    {
+      *min = t;
+      return t->right;
+    }
+  t->left = tree_remove_min (t->left, min);
+  return balance (t);
+}
+
+/* Removes VMA from the subtree at T.  Returns the new root. */
+static struct vma *
+tree_remove (struct vma *t, struct vma *vma)
+{
+  ASSERT (t != NULL);
+  if (vma->start < t->start)
+    t->left = tree_remove (t->left, vma);
+  else if (vma->start > t->start)
+    t->right = tree_remove (t->right, vma);
+  else
+    {
+      struct vma *min;
+      if (t->right == NULL)
+        return t->left;
+      t->right = tree_remove_min (t->right, &min);
+      min->left = t->left;
+      min->right = t->right;
+      t = min;
+    }
+  return balance (t);
+}
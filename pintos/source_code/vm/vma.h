@@ -0,0 +1,45 @@
+#ifndef VM_VMA
+#define VM_VMA
+
+#include <list.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "filesys/off_t.h"
+#include "vm/page.h"
+
+/* A region of a process's address space, [START, END), page
+   aligned: an executable segment, a file mapping or the stack.
+   Pages of a FILE or MMAP region get an spt_entry only when they
+   are first touched; those entries are kept on PAGES.
+
+   Each process keeps its regions in an AVL tree ordered by start
+   address.  Regions never overlap, so this order makes it an
+   interval tree without any further bookkeeping. */
+struct vma
+  {
+    uint8_t *start;             /* First byte. */
+    uint8_t *end;               /* One past the last byte. */
+    enum spte_type type;        /* Type of the pages. */
+    struct file *file;          /* File the pages come from, if any. */
+    off_t ofs;                  /* Offset in FILE of START. */
+    uint32_t read_bytes;        /* Bytes read from FILE; the rest is zero. */
+    bool writable;              /* Pages may be written. */
+    int advice;                 /* MADV_NORMAL, MADV_RANDOM or
+                                   MADV_SEQUENTIAL. */
+    bool huge;                  /* MADV_HUGEPAGE: use large pages. */
+    struct list pages;          /* spt_entry's created so far. */
+
+    struct vma *left, *right;   /* Children in the region tree. */
+    int height;                 /* Height of the subtree. */
+  };
+
+struct vma *vma_create (struct vma **, void *, void *, enum spte_type,
+                        struct file *, off_t, uint32_t, bool);
+struct vma *vma_find (struct vma *, const void *);
+bool vma_overlaps (struct vma *, const void *, const void *);
+void vma_remove (struct vma **, struct vma *);
+struct vma *vma_split (struct vma **, struct vma *, void *);
+bool vma_fork (struct vma *, struct vma **);
+void vma_destroy (struct vma **);
+
+#endif
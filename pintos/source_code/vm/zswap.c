@@ -0,0 +1,505 @@
+#include "vm/zswap.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <round.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "vm/swap.h"
+
+/* Compressed swap cache.
+
+   Pages on their way to the swap disk are compressed and kept in
+   a bounded pool of kernel pages instead.  The swap slot is still
+   allocated, so a page can always be written back to it: when the
+   pool is full, the least recently stored pages are decompressed
+   and written to their slots to make room.  Pages that do not
+   compress to ZSWAP_MAX_LEN bytes go to the disk directly.
+
+   The pool is carved into ZSWAP_CHUNK-byte chunks; a compressed
+   page takes a run of chunks within one pool page. */
+
+/* Maximum number of kernel pages in the pool. */
+#define ZSWAP_POOL_PAGES 64
+
+/* Allocation unit within a pool page. */
+#define ZSWAP_CHUNK 64
+#define ZSWAP_CHUNKS_PER_PAGE (PGSIZE / ZSWAP_CHUNK)
+
+/* Pages that compress worse than this are not stored. */
+#define ZSWAP_MAX_LEN (PGSIZE * 3 / 4)
+
+/* A compressed page. */
+struct zswap_entry
+  {
+    size_t slot;                /* Swap slot the page belongs to. */
+    int pool_page;              /* Index in zpool. */
+    uint8_t chunk;              /* First chunk in the pool page. */
+    uint8_t chunk_cnt;          /* Number of chunks. */
+    uint16_t len;               /* Compressed size in bytes. */
+    struct hash_elem hash_elem; /* Element in zswap_table. */
+    struct list_elem lru_elem;  /* Element in zswap_lru. */
+  };
+
+/* A page of the pool.  Bit I of USED is set if chunk I holds
+   data; BASE is null while the page is not allocated. */
+struct zpool_page
+  {
+    uint8_t *base;
+    uint64_t used;
+  };
+
+static struct lock zswap_lock;
+static struct zpool_page zpool[ZSWAP_POOL_PAGES];
+static int zpool_page_cnt;              /* Allocated pool pages. */
+static struct hash zswap_table;         /* Entries, by swap slot. */
+static size_t zswap_slot_cnt;
+static struct list zswap_lru;           /* Least recently stored first. */
+
+/* Scratch buffers, used with zswap_lock held. */
+static uint8_t zswap_cbuf[ZSWAP_MAX_LEN];
+static uint8_t zswap_dbuf[PGSIZE];
+
+/* Statistics. */
+static long long store_cnt;
+static long long reject_cnt;
+static long long hit_cnt;
+static long long writeback_cnt;
+static long long stored_bytes;
+static long long compressed_bytes;
+
+/* LZ compressor. */
+#define LZ_MIN_MATCH 4
+#define LZ_HASH_BITS 12
+static uint16_t lz_hash_table[1 << LZ_HASH_BITS];
+static size_t lz_compress (const uint8_t *, size_t, uint8_t *, size_t);
+static size_t lz_decompress (const uint8_t *, size_t, uint8_t *, size_t);
+
+static hash_hash_func zswap_hash;
+static hash_less_func zswap_less;
+static struct zswap_entry *find_entry (size_t);
+static bool zpool_alloc (struct zswap_entry *);
+static uint8_t *entry_data (const struct zswap_entry *);
+static void drop_entry (struct zswap_entry *);
+static bool writeback_lru (void);
+
+/* Initializes the compressed cache for swap devices of SLOT_CNT
+   slots.  Entries are found by slot in a hash table, which takes
+   memory only for the pages cached, not for every slot. */
+void
+zswap_init (size_t slot_cnt)
+{
+  lock_init (&zswap_lock);
+  list_init (&zswap_lru);
+  zswap_slot_cnt = slot_cnt;
+  if (!hash_init (&zswap_table, zswap_hash, zswap_less, NULL))
+    PANIC ("Not able to allocate zswap table");
+}
+
+/* Compresses PAGE and keeps it for swap slot SLOT.  Returns false
+   if it was not stored, in which case the caller writes it to the
+   disk. */
+bool
+zswap_store (size_t slot, const void *page)
+{
+  struct zswap_entry *e;
+  size_t len;
+
+  ASSERT (slot < zswap_slot_cnt);
+  lock_acquire (&zswap_lock);
+  len = lz_compress (page, PGSIZE, zswap_cbuf, ZSWAP_MAX_LEN);
+  e = len > 0 ? malloc (sizeof *e) : NULL;
+  if (e == NULL)
+    {
+      reject_cnt++;
+      lock_release (&zswap_lock);
+      return false;
+    }
+  e->slot = slot;
+  e->len = len;
+  e->chunk_cnt = DIV_ROUND_UP (len, ZSWAP_CHUNK);
+
+  /* Make room by writing back the oldest pages. */
+  while (!zpool_alloc (e))
+    if (!writeback_lru ())
+      {
+        free (e);
+        reject_cnt++;
+        lock_release (&zswap_lock);
+        return false;
+      }
+
+  memcpy (entry_data (e), zswap_cbuf, len);
+  hash_insert (&zswap_table, &e->hash_elem);
+  list_push_back (&zswap_lru, &e->lru_elem);
+  store_cnt++;
+  stored_bytes += PGSIZE;
+  compressed_bytes += len;
+  lock_release (&zswap_lock);
+  return true;
+}
+
+/* Decompresses the page of swap slot SLOT into PAGE.  The page
+   stays cached until the slot is freed, since a slot shared after
+   fork() is read once by every process holding it.  Returns false
+   if the slot is not cached. */
+bool
+zswap_load (size_t slot, void *page)
+{
+  struct zswap_entry *e;
+
+  ASSERT (slot < zswap_slot_cnt);
+  lock_acquire (&zswap_lock);
+  e = find_entry (slot);
+  if (e != NULL)
+    {
+      if (lz_decompress (entry_data (e), e->len, page, PGSIZE) != PGSIZE)
+        PANIC ("zswap: corrupt page in slot %zu", slot);
+      hit_cnt++;
+    }
+  lock_release (&zswap_lock);
+  return e != NULL;
+}
+
+/* Returns true if the page of swap slot SLOT is in the cache, and
+   so not on the disk. */
+bool
+zswap_contains (size_t slot)
+{
+  bool found;
+
+  ASSERT (slot < zswap_slot_cnt);
+  lock_acquire (&zswap_lock);
+  found = find_entry (slot) != NULL;
+  lock_release (&zswap_lock);
+  return found;
+}
+
+/* Drops the page of swap slot SLOT, which is being freed, from
+   the cache. */
+void
+zswap_invalidate (size_t slot)
+{
+  struct zswap_entry *e;
+
+  ASSERT (slot < zswap_slot_cnt);
+  lock_acquire (&zswap_lock);
+  e = find_entry (slot);
+  if (e != NULL)
+    drop_entry (e);
+  lock_release (&zswap_lock);
+}
+
+/* Prints compressed cache statistics. */
+void
+zswap_print_stats (void)
+{
+  long long ratio = compressed_bytes > 0
+                    ? stored_bytes * 100 / compressed_bytes : 0;
+
+  printf ("Zswap: %lld pages stored, %lld rejected, %lld hits, "
+          "%lld writebacks\n", store_cnt, reject_cnt, hit_cnt, writeback_cnt);
+  printf ("Zswap: compression ratio %lld.%02lld, %d of %d pool pages in use\n",
+          ratio / 100, ratio % 100, zpool_page_cnt, ZSWAP_POOL_PAGES);
+}
+
+/* Returns the hash of the slot of compressed page E. */
+static unsigned
+zswap_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_int (hash_entry (e, struct zswap_entry, hash_elem)->slot);
+}
+
+/* Orders compressed pages by slot. */
+static bool
+zswap_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED)
+{
+  return hash_entry (a, struct zswap_entry, hash_elem)->slot
+         < hash_entry (b, struct zswap_entry, hash_elem)->slot;
+}
+
+/* Returns the cached page of swap slot SLOT, or a null pointer if
+   it is not cached.  Called with zswap_lock held. */
+static struct zswap_entry *
+find_entry (size_t slot)
+{
+  struct zswap_entry key;
+  struct hash_elem *e;
+
+  ASSERT (lock_held_by_current_thread (&zswap_lock));
+  key.slot = slot;
+  e = hash_find (&zswap_table, &key.hash_elem);
+  return e != NULL ? hash_entry (e, struct zswap_entry, hash_elem) : NULL;
+}
+
+/* Finds room for E's chunks in the pool, allocating a new pool
+   page if none of the current ones has a long enough free run.
+   Returns false if the pool is full. */
+static bool
+zpool_alloc (struct zswap_entry *e)
+{
+  uint64_t mask = ((uint64_t) 1 << e->chunk_cnt) - 1;
+  int i, free_page = -1;
+
+  for (i = 0; i < ZSWAP_POOL_PAGES; i++)
+    {
+      struct zpool_page *p = &zpool[i];
+      int c;
+
+      if (p->base == NULL)
+        {
+          if (free_page < 0)
+            free_page = i;
+          continue;
+        }
+      for (c = 0; c + e->chunk_cnt <= ZSWAP_CHUNKS_PER_PAGE; c++)
+        if ((p->used & (mask << c)) == 0)
+          {
+            p->used |= mask << c;
+            e->pool_page = i;
+            e->chunk = c;
+            return true;
+          }
+    }
+
+  if (free_page < 0)
+    return false;
+  zpool[free_page].base = palloc_get_page (0);
+  if (zpool[free_page].base == NULL)
+    return false;
+  zpool[free_page].used = mask;
+  zpool_page_cnt++;
+  e->pool_page = free_page;
+  e->chunk = 0;
+  return true;
+}
+
+/* Returns the compressed data of E. */
+static uint8_t *
+entry_data (const struct zswap_entry *e)
+{
+  return zpool[e->pool_page].base + e->chunk * ZSWAP_CHUNK;
+}
+
+/* Removes E from the cache and frees its chunks, giving the pool
+   page back to the kernel once it is empty. */
+static void
+drop_entry (struct zswap_entry *e)
+{
+  struct zpool_page *p = &zpool[e->pool_page];
+  uint64_t mask = ((uint64_t) 1 << e->chunk_cnt) - 1;
+
+  ASSERT (lock_held_by_current_thread (&zswap_lock));
+  p->used &= ~(mask << e->chunk);
+  if (p->used == 0)
+    {
+      palloc_free_page (p->base);
+      p->base = NULL;
+      zpool_page_cnt--;
+    }
+  hash_delete (&zswap_table, &e->hash_elem);
+  list_remove (&e->lru_elem);
+  free (e);
+}
+
+/* Writes the least recently stored page back to its swap slot.
+   Returns false if the cache is empty.  The write is done with
+   zswap_lock held, so a concurrent load of the slot finds the page
+   either here or on the disk. */
+static bool
+writeback_lru (void)
+{
+  struct zswap_entry *e;
+
+  ASSERT (lock_held_by_current_thread (&zswap_lock));
+  if (list_empty (&zswap_lru))
+    return false;
+  e = list_entry (list_front (&zswap_lru), struct zswap_entry, lru_elem);
+  if (lz_decompress (entry_data (e), e->len, zswap_dbuf, PGSIZE) != PGSIZE)
+    PANIC ("zswap: corrupt page in slot %zu", e->slot);
+  swap_write_slot (e->slot, zswap_dbuf);
+  drop_entry (e);
+  writeback_cnt++;
+  return true;
+}
+
+
+/* Reads 4 bytes from P, which need not be aligned. */
+static uint32_t
+lz_read32 (const uint8_t *p)
+{
+  uint32_t v;
+  memcpy (&v, p, sizeof v);
+  return v;
+}
+
+/* Hashes the 4-byte sequence V into the match table. */
+static unsigned
+lz_hash (uint32_t v)
+{
+  return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+/* Writes the part of length LEN that did not fit in a token
+   nibble to OP as a run of 255s and a final byte.  Returns the
+   new output position, or a null pointer if OEND is reached. */
+static uint8_t *
+lz_put_len (uint8_t *op, uint8_t *oend, size_t len)
+{
+  for (;;)
+    {
+      if (op >= oend)
+        return NULL;
+      if (len < 255)
+        break;
+      *op++ = 255;
+      len -= 255;
+    }
+  *op++ = len;
+  return op;
+}
+
+/* Writes one sequence to OP: a token, LIT_LEN literal bytes from
+   LIT and, if OFFSET is nonzero, a match of MATCH_LEN +
+   LZ_MIN_MATCH bytes OFFSET bytes back.  Returns the new output
+   position, or a null pointer if OEND is reached. */
+static uint8_t *
+lz_emit (uint8_t *op, uint8_t *oend, const uint8_t *lit, size_t lit_len,
+         size_t offset, size_t match_len)
+{
+  uint8_t *token;
+
+  if (op >= oend)
+    return NULL;
+  token = op++;
+  *token = (lit_len < 15 ? lit_len : 15) << 4;
+  if (lit_len >= 15 && (op = lz_put_len (op, oend, lit_len - 15)) == NULL)
+    return NULL;
+  if ((size_t) (oend - op) < lit_len)
+    return NULL;
+  memcpy (op, lit, lit_len);
+  op += lit_len;
+
+  if (offset != 0)
+    {
+      if (oend - op < 2)
+        return NULL;
+      *op++ = offset & 0xff;
+      *op++ = offset >> 8;
+      *token |= match_len < 15 ? match_len : 15;
+      if (match_len >= 15
+          && (op = lz_put_len (op, oend, match_len - 15)) == NULL)
+        return NULL;
+    }
+  return op;
+}
+
+/* Compresses the SRC_LEN bytes at SRC into at most DST_MAX bytes
+   at DST.  Returns the compressed size, or 0 if it does not fit.
+   The format is that of LZ4 blocks: each token byte holds a
+   literal length and a match length, followed by the literals, a
+   2-byte match offset and length extension bytes.  The last
+   sequence has no match. */
+static size_t
+lz_compress (const uint8_t *src, size_t src_len, uint8_t *dst, size_t dst_max)
+{
+  const uint8_t *ip = src, *anchor = src;
+  const uint8_t *iend = src + src_len;
+  uint8_t *op = dst, *oend = dst + dst_max;
+
+  memset (lz_hash_table, 0, sizeof lz_hash_table);
+  while (src_len >= LZ_MIN_MATCH && ip <= iend - LZ_MIN_MATCH)
+    {
+      uint32_t seq = lz_read32 (ip);
+      unsigned h = lz_hash (seq);
+      const uint8_t *ref = src + lz_hash_table[h];
+      const uint8_t *mp, *rp;
+
+      lz_hash_table[h] = ip - src;
+      if (ref >= ip || lz_read32 (ref) != seq)
+        {
+          ip++;
+          continue;
+        }
+
+      for (mp = ip + LZ_MIN_MATCH, rp = ref + LZ_MIN_MATCH;
+           mp < iend && *mp == *rp; mp++, rp++)
+        continue;
+      op = lz_emit (op, oend, anchor, ip - anchor, ip - ref,
+                    (mp - ip) - LZ_MIN_MATCH);
+      if (op == NULL)
+        return 0;
+      ip = anchor = mp;
+    }
+
+  op = lz_emit (op, oend, anchor, iend - anchor, 0, 0);
+  return op != NULL ? (size_t) (op - dst) : 0;
+}
+
+/* Adds the length extension bytes at *IP to *LEN. */
+static bool
+lz_get_len (const uint8_t **ip, const uint8_t *iend, size_t *len)
+{
+  uint8_t b;
+  do
+    {
+      if (*ip >= iend)
+        return false;
+      b = *(*ip)++;
+      *len += b;
+    }
+  while (b == 255);
+  return true;
+}
+
+/* Decompresses the SRC_LEN bytes at SRC into at most DST_MAX
+   bytes at DST.  Returns the decompressed size, or 0 if the input
+   is corrupt. */
+static size_t
+lz_decompress (const uint8_t *src, size_t src_len, uint8_t *dst,
+               size_t dst_max)
+{
+  const uint8_t *ip = src, *iend = src + src_len;
+  uint8_t *op = dst, *oend = dst + dst_max;
+
+  while (ip < iend)
+    {
+      unsigned token = *ip++;
+      size_t len = token >> 4;
+      size_t offset;
+      const uint8_t *ref;
+
+      if (len == 15 && !lz_get_len (&ip, iend, &len))
+        return 0;
+      if ((size_t) (iend - ip) < len || (size_t) (oend - op) < len)
+        return 0;
+      memcpy (op, ip, len);
+      op += len;
+      ip += len;
+      if (ip == iend)
+        break;
+
+      if (iend - ip < 2)
+        return 0;
+      offset = ip[0] | (ip[1] << 8);
+      ip += 2;
+      if (offset == 0 || offset > (size_t) (op - dst))
+        return 0;
+      len = token & 15;
+      if (len == 15 && !lz_get_len (&ip, iend, &len))
+        return 0;
+      len += LZ_MIN_MATCH;
+      if ((size_t) (oend - op) < len)
+        return 0;
+      for (ref = op - offset; len > 0; len--)
+        *op++ = *ref++;
+    }
+  return op - dst;
+}
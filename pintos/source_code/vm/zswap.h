@@ -0,0 +1,14 @@
+#ifndef VM_ZSWAP
+#define VM_ZSWAP
+
+#include <stdbool.h>
+#include <stddef.h>
+
+void zswap_init (size_t);
+bool zswap_store (size_t, const void *);
+bool zswap_load (size_t, void *);
+bool zswap_contains (size_t);
+void zswap_invalidate (size_t);
+void zswap_print_stats (void);
+
+#endif